@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include "../src/def.hpp"
+#include "../src/render/render.hpp"
+#include "../src/render/src/figures/figure_render.hpp"
+
+float hse::time;                    // Global time variable
+float hse::deltaTime;               // Global delta time variable
+bool hse::isPause;                  // Pause flag
+unsigned int hse::windowWidth,      // Window width
+    hse::windowHeight;              // Window height
+std::map<int, hse::Key> hse::keys;  // Keys map for input response
+
+namespace {
+/* Create synthetic figure tree function.
+ * ARGUMENTS:
+ *   - number of primitives in the tree:
+ *       int primitivesCount;
+ *   - use all operations (otherwise union only) flag:
+ *       bool isMixed.
+ * RETURNS:
+ *   (hse::FigureId) - root of the left-deep tree (2 * primitivesCount - 1 nodes).
+ */
+hse::FigureId createTree(int primitivesCount, bool isMixed) {
+    using namespace hse;
+    using namespace math;
+    FigureScene &scene = Render::scene;
+
+    auto twist = scene.createTwist(vec3(0), vec3(0, 1, 0), 0.5);
+    FigureId root(-1);
+    for (int i = 0; i < primitivesCount; i++) {
+        auto prim = i % 2 == 0 ? scene.createSphere(0.3) : scene.createBox(0.3);
+        prim << matr4::translate(vec3(static_cast<float>(i % 100), static_cast<float>(i / 100 % 100), 0) * 0.5);
+        if (isMixed && i % 7 == 0) {
+            prim << twist;
+        }
+        if (i == 0) {
+            root = prim;
+        } else if (!isMixed || i % 4 == 0) {
+            root |= prim;
+        } else if (i % 4 == 1) {
+            root %= prim;
+        } else if (i % 4 == 2) {
+            root /= prim;
+        } else {
+            root &= prim;
+        }
+    }
+    return root;
+}
+
+/* Measure function average time function.
+ * ARGUMENTS:
+ *   - function to measure:
+ *       const std::function<void()> &func;
+ *   - repeats count:
+ *       int repeatsCount.
+ * RETURNS:
+ *   (double) - average time in milliseconds.
+ */
+double measure(const std::function<void()> &func, int repeatsCount) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeatsCount; i++) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repeatsCount;
+}
+}  // namespace
+
+static int maxNodesCount = 100000;  // Size of the biggest measured tree
+
+// Function for generate render instance variable
+void hse::factory() {
+    // GL context is needed only by render resources destructors
+    hse::Render renderInstance;
+    renderInstance.onCreate(64, 64);
+
+    hse::FigureScene &scene = hse::Render::scene;
+    hse::RMRender render;
+    std::printf("%8s %8s %10s %10s %14s %12s\n", "tree", "nodes", "balancing", "time (ms)", "source (KiB)", "hash");
+    for (bool isMixed : {false, true}) {
+        for (int nodesCount = 10; nodesCount <= maxNodesCount; nodesCount *= 10) {
+            int count = nodesCount / 2;
+            for (auto id : std::vector<hse::FigureId>(scene.getScene().begin(), scene.getScene().end())) {
+                id.hide();
+            }
+            createTree(count, isMixed).draw();
+            for (bool isBalancing : {false, true}) {
+                scene.setBalancing(isBalancing);
+                std::string source;
+                double time = measure([&]() { source = render.getSDFSceneSource(); }, std::max(1, 10000 / count));
+                std::printf(
+                    "%8s %8d %10s %10.3f %14.1f %12zx\n", isMixed ? "mixed" : "union", 2 * count - 1,
+                    isBalancing ? "on" : "off", time, source.size() / 1024.0, std::hash<std::string>{}(source) & 0xFFFFFFFF
+                );
+            }
+        }
+    }
+}  // End of 'hse::factory' function
+
+// Benchmark program function (usage: codegen-bench [max nodes count])
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        maxNodesCount = std::atoi(argv[1]);
+    }
+    hse::factory();
+    return 0;
+}  // End of 'main' function
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include "../src/def.hpp"
+#include "../src/render/render.hpp"
+#include "rm_bench_unit.hpp"
+
+float hse::time;                    // Global time variable
+float hse::deltaTime;               // Global delta time variable
+bool hse::isPause;                  // Pause flag
+unsigned int hse::windowWidth,      // Window width
+    hse::windowHeight;              // Window height
+std::map<int, hse::Key> hse::keys;  // Keys map for input response
+
+static std::vector<int> primitivesCounts = {10, 100, 1000};  // Union chain lengths to measure
+static int measuredFramesCount = 20;                         // Frames to average per run
+
+// Function for generate render instance variable
+void hse::factory() {
+    hse::Render renderInstance;
+
+    renderInstance.onCreate(500, 500);
+    renderInstance.addScene(new hse::rmBenchScene(primitivesCounts, measuredFramesCount));
+    renderInstance.startRenderLoop();
+}  // End of 'hse::factory' function
+
+// Benchmark program function (usage: rm-bench [frames per run] [primitives count...])
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        measuredFramesCount = std::max(1, std::atoi(argv[1]));
+    }
+    if (argc > 2) {
+        primitivesCounts.clear();
+        for (int i = 2; i < argc; i++) {
+            primitivesCounts.push_back(std::max(1, std::atoi(argv[i])));
+        }
+    }
+    // Fresh cache directory, so every shader program is really compiled
+    auto cacheDir = std::filesystem::temp_directory_path() /
+                    ("hse_rm_bench_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::filesystem::create_directories(cacheDir);
+#ifdef _WIN32
+    _putenv_s("XDG_CACHE_HOME", cacheDir.string().c_str());
+    _putenv_s("MESA_SHADER_CACHE_DISABLE", "true");
+#else
+    setenv("XDG_CACHE_HOME", cacheDir.string().c_str(), 1);
+    setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+#endif
+    hse::factory();
+    std::filesystem::remove_all(cacheDir);
+    return 0;
+}  // End of 'main' function
@@ -0,0 +1,97 @@
+#include "rm_bench_unit.hpp"
+#include <cstdio>
+#include "../src/render/src/figures/figure_scene.hpp"
+
+// Project namespace
+namespace hse {
+void rmBenchScene::onCreate() {
+    using namespace math;
+    FigureScene &scene = Render::scene;
+
+    for (int count : primitivesCounts) {
+        // Spheres on the cube grid, united one by one (left-deep chain)
+        int side = static_cast<int>(std::ceil(std::cbrt(static_cast<float>(count))));
+        float step = 4.0f / static_cast<float>(side);
+        FigureId chain(-1);
+        for (int i = 0; i < count; i++) {
+            vec3 pos(
+                static_cast<float>(i % side), static_cast<float>(i / side % side),
+                static_cast<float>(i / (side * side))
+            );
+            auto sph = scene.createSphere(step * 0.4f, vec3(0.4, 0.6, 0.9));
+            sph << matr4::translate((pos - vec3(static_cast<float>(side - 1) / 2)) * step);
+            if (i == 0) {
+                chain = sph;
+            } else {
+                chain |= sph;
+            }
+        }
+        chains.push_back(chain);
+        runs.push_back({count, false, 0, 0});
+        runs.push_back({count, true, 0, 0});
+    }
+    scene.setRenderType(RenderType::RM);
+
+    vec3 cameraLocation = vec3(1, 0.7, 1) * 6;
+    vec3 dir = (vec3(0) - cameraLocation).normalize();
+    vec3 right = dir % vec3(0, 1, 0);
+    vec3 up = (right % dir).normalize();
+    scene.mainCamera.setAllAxis(cameraLocation, dir, up, right);
+}
+
+void rmBenchScene::startRun(int runIndex) {
+    FigureScene &scene = Render::scene;
+
+    for (auto &chain : chains) {
+        chain.hide();
+    }
+    chains[runIndex / 2].draw();
+    scene.setBalancing(runs[runIndex].isBalancing);
+    curRun = runIndex;
+    curFrame = 0;
+    glFinish();
+    startTime = Clock::now();
+}
+
+void rmBenchScene::onUpdate() {
+    if (curRun < 0) {
+        // Render is initialized now, so the first run compile time is measured too
+        startRun(0);
+        return;
+    }
+    if (curRun >= static_cast<int>(runs.size())) {
+        return;
+    }
+    // Wait for previous frame, so the measured time includes GPU work
+    glFinish();
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double, std::milli>(now - startTime).count();
+
+    if (curFrame == 0) {
+        // Previous frame recompiled the scene program
+        runs[curRun].compileTime = elapsed;
+        startTime = now;
+    } else if (curFrame == measuredFramesCount) {
+        runs[curRun].frameTime = elapsed / measuredFramesCount;
+        if (curRun + 1 < static_cast<int>(runs.size())) {
+            startRun(curRun + 1);
+            return;
+        }
+        printResults();
+        curRun++;
+        glfwSetWindowShouldClose(glfwGetCurrentContext(), GLFW_TRUE);
+        return;
+    }
+    curFrame++;
+}
+
+void rmBenchScene::printResults() const {
+    std::printf("%12s %10s %14s %14s\n", "primitives", "balancing", "compile (ms)", "frame (ms)");
+    for (auto &run : runs) {
+        std::printf(
+            "%12d %10s %14.2f %14.2f\n", run.primitivesCount, run.isBalancing ? "on" : "off", run.compileTime,
+            run.frameTime
+        );
+    }
+}
+}  // namespace hse
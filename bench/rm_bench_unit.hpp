@@ -0,0 +1,69 @@
+#ifndef RM_BENCH_UNIT_HPP
+#define RM_BENCH_UNIT_HPP
+
+#include <chrono>
+#include "../src/def.hpp"
+#include "../src/render/render.hpp"
+#include "../src/render/src/resources/scenes/scene.hpp"
+
+// Project namespace
+namespace hse {
+// Ray marching benchmark scene: union chains of growing length with and without chain balancing
+class rmBenchScene final : public Scene {
+    using Clock = std::chrono::steady_clock;
+
+    // Single benchmark run description
+    struct BenchRun {
+        int primitivesCount;  // Number of spheres in the union chain
+        bool isBalancing;     // Chain balancing flag
+        double compileTime;   // Time of the first frame after the switch (ms)
+        double frameTime;     // Average time of the following frames (ms)
+    };
+
+    std::vector<int> primitivesCounts;  // Union chain lengths to measure
+    int measuredFramesCount;           // Frames to average per run
+    std::vector<FigureId> chains;  // Union chain for each primitives count
+    std::vector<BenchRun> runs;    // All benchmark runs
+    int curRun;                    // Current run index
+    int curFrame;                  // Frame index inside current run
+    Clock::time_point startTime;   // Measurement start time
+
+public:
+    /* Class constructor.
+     * ARGUMENTS:
+     *   - union chain lengths to measure:
+     *       std::vector<int> primitivesCounts_;
+     *   - frames to average per run:
+     *       int measuredFramesCount_.
+     */
+    explicit rmBenchScene(std::vector<int> primitivesCounts_ = {10, 100, 1000}, int measuredFramesCount_ = 20)
+        : primitivesCounts(std::move(primitivesCounts_)),
+          measuredFramesCount(measuredFramesCount_),
+          curRun(-1),
+          curFrame(0) {
+    }
+
+    void onCreate() final;
+
+    void onUpdate() final;
+
+    ~rmBenchScene() final = default;
+
+private:
+    /* Start benchmark run function.
+     * ARGUMENTS:
+     *   - run index:
+     *       int runIndex.
+     * RETURNS: None.
+     */
+    void startRun(int runIndex);
+
+    /* Print benchmark results function.
+     * ARGUMENTS: None.
+     * RETURNS: None.
+     */
+    void printResults() const;
+};  // End of 'rmBenchScene' class
+}  // namespace hse
+
+#endif  // RM_BENCH_UNIT_HPP
@@ -0,0 +1,22 @@
+#version 460 core
+
+layout(local_size_x = RM_ACCUMULATE_GROUP_SIZE, local_size_y = RM_ACCUMULATE_GROUP_SIZE) in;
+
+// Frame of the current sample (replaced by the accumulated one) and the mean of the previous samples
+layout(binding = 0, rgba16f) uniform image2D frame_image;
+layout(binding = 1, rgba16f) uniform image2D accum_image;
+
+uniform int frame_w;
+uniform int frame_h;
+uniform float weight; // of the current sample (1 / samples count)
+
+// Main shader program function: add the frame to the running mean of the still frame samples
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= frame_w || pixel.y >= frame_h) {
+        return;
+    }
+    vec4 color = mix(imageLoad(accum_image, pixel), imageLoad(frame_image, pixel), weight);
+    imageStore(accum_image, pixel, color);
+    imageStore(frame_image, pixel, color);
+} // End of 'main' function
@@ -0,0 +1,47 @@
+#version 460 core
+
+out vec4 outColor;
+
+// Frame traced at render resolution
+uniform sampler2D frame_texture;
+// Hit distances from camera of the frame (0 if there is no hit)
+layout(binding = 2) uniform sampler2D hit_dist_texture;
+uniform int screen_w;
+uniform int screen_h;
+uniform float sharpness;
+uniform mat4 viewProjection;
+uniform vec3 cam_pos;
+uniform vec3 cam_dir;
+uniform vec3 cam_up;
+uniform vec3 cam_right;
+
+// Depth of the hit seen by the window pixel (meshes and figures occlude each other), background is the farthest
+float get_hit_depth()
+{
+    ivec2 size = textureSize(hit_dist_texture, 0);
+    float dist = texelFetch(hit_dist_texture, ivec2(gl_FragCoord.xy * vec2(size) / vec2(screen_w, screen_h)), 0).r;
+    if (dist <= 0) {
+        return 1;
+    }
+    // Same as 'get_pixel_pos' of rm shader
+    vec2 coord = gl_FragCoord.xy / vec2(screen_w, screen_h) - 0.5;
+    vec3 dir = normalize(cam_dir + normalize(cam_up) * coord.y + normalize(cam_right) * coord.x);
+    vec4 pos = viewProjection * vec4(cam_pos + dir * dist, 1);
+    return pos.z / pos.w * 0.5 + 0.5;
+}
+
+// Main shader program function
+void main() {
+    gl_FragDepth = get_hit_depth();
+    ivec2 size = textureSize(frame_texture, 0);
+    if (size == ivec2(screen_w, screen_h)) {
+        outColor = texelFetch(frame_texture, ivec2(gl_FragCoord.xy), 0);
+        return;
+    }
+    vec2 uv = gl_FragCoord.xy / vec2(screen_w, screen_h), texel = 1.0 / vec2(size);
+    vec4 color = texture(frame_texture, uv);
+    // Unsharp mask over bilinear upscale
+    vec4 neighbours = texture(frame_texture, uv + vec2(texel.x, 0)) + texture(frame_texture, uv - vec2(texel.x, 0)) +
+        texture(frame_texture, uv + vec2(0, texel.y)) + texture(frame_texture, uv - vec2(0, texel.y));
+    outColor = vec4(clamp(color + (color * 4 - neighbours) * sharpness, 0, 1).rgb, 1);
+} // End of 'main' function
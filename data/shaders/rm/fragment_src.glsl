@@ -1,12 +1,42 @@
 #version 460 core
 #define PI 3.141592653589793
 
-out vec4 outColor;
+#if defined(RM_LIGHTING) || defined(RM_SECONDARY) || defined(RM_COMPOSITE) || defined(RM_STEPS)
+#define RM_DEFERRED_PASS
+#endif
+
+#if defined(RM_CONE_PREPASS)
+layout(local_size_x = RM_CONE_GROUP_SIZE, local_size_y = RM_CONE_GROUP_SIZE) in;
+layout(binding = 1, r32f) uniform writeonly image2D start_image;
+#elif defined(RM_DEFERRED_PASS)
+layout(local_size_x = RM_DEFERRED_GROUP_SIZE, local_size_y = RM_DEFERRED_GROUP_SIZE) in;
+layout(binding = 0, rgba16f) uniform image2D frame_image;
+#elif defined(RM_COMPUTE)
+layout(local_size_x = RM_TILE_SIZE, local_size_y = RM_TILE_SIZE) in;
+layout(binding = 1, r32f) uniform readonly image2D start_image;
+#if !defined(RM_USE_DEFERRED)
+// Color of the pixel shaded by tracing pass itself
+layout(binding = 0, rgba16f) uniform writeonly image2D frame_image;
+#endif
+#else
+#if defined(RM_USE_DEFERRED)
+// G-buffer of the pixel (framebuffer attachments)
+layout(location = 0) out vec4 out_material;
+layout(location = 1) out vec4 out_normal;
+#else
+// Color of the pixel shaded by tracing pass itself (framebuffer attachments, as G-buffer without normals)
+layout(location = 0) out vec4 out_color;
+#endif
+layout(location = 2) out float out_dist;
 in vec3 inColor;
+layout(binding = 1, r32f) uniform readonly image2D start_image;
+#endif
 
 uniform float time;
 uniform int frame_w;
 uniform int frame_h;
+uniform float jitter_x; // sub-pixel offset of the rays (refinement samples of the still frame)
+uniform float jitter_y;
 uniform vec3 cam_pos;
 uniform vec3 cam_dir;
 uniform vec3 cam_up;
@@ -14,6 +44,57 @@ uniform vec3 cam_right;
 uniform int is_bulb;
 uniform vec3 bulb_pos;
 uniform vec3 bulb_color;
+uniform int is_simple_shading; // secondary rays are skipped (set by frame time governor)
+uniform int secondary_scale; // pixels of secondary pass per side of its pixel
+uniform vec3 prev_cam_pos;
+uniform vec3 prev_cam_dir;
+uniform vec3 prev_cam_up;
+uniform vec3 prev_cam_right;
+uniform vec3 scene_min; // box of all drawn figures (secondary rays are clipped by it, lights are binned over it)
+uniform vec3 scene_max;
+uniform int max_steps; // steps of every marched ray (ray out of them is missed)
+uniform float relaxation; // steps are this times longer than distances while they skip no surfaces (1 - plain sphere tracing)
+
+/* G-buffer of the current frame:
+ *   hit distances from camera (0 if there is no hit, also reprojected by the next frame),
+ *   normals ('w' is 0 if surface is not lit),
+ *   materials (color and light source flag, background is black). */
+#if defined(RM_DEFERRED_PASS)
+layout(binding = 2, r32f) uniform readonly image2D history_image;
+layout(binding = 5, rgba16f) uniform readonly image2D normal_image;
+#if defined(RM_LIGHTING)
+layout(binding = 6, rgba8) uniform readonly image2D material_image;
+#elif !defined(RM_STEPS)
+// Secondary effects at lower resolution: reflection color and occlusion ('w', -1 if there is no surface), bulb light
+layout(binding = 6, rgba16f) uniform image2D effects_image;
+layout(binding = 7, r16f) uniform image2D bulb_light_image;
+#if defined(RM_COMPOSITE)
+// Colors of the surfaces lit by point lights (their unit is taken by effects)
+layout(binding = 3, rgba8) uniform readonly image2D material_image;
+#endif
+#endif
+#elif !defined(RM_CONE_PREPASS)
+// Hit distances from camera of the previous frame and hints reprojected from it (float bits)
+layout(binding = 4, r32f) uniform readonly image2D prev_history_image;
+layout(binding = 3, r32ui) uniform readonly uimage2D hint_image;
+#if defined(RM_COMPUTE)
+layout(binding = 2, r32f) uniform writeonly image2D history_image;
+#if defined(RM_USE_DEFERRED)
+layout(binding = 5, rgba16f) uniform writeonly image2D normal_image;
+layout(binding = 6, rgba8) uniform writeonly image2D material_image;
+#endif
+#endif
+#endif
+#if !defined(RM_DEFERRED_PASS)
+// Distances from camera to the nearest box entry and to the farthest box exit (negated) of drawn figures,
+// rasterized by their proxy boxes ('x' exceeds 'max_dist' if the pixel sees background only)
+layout(binding = 7, rg32f) uniform readonly image2D proxy_image;
+#endif
+#if !defined(RM_CONE_PREPASS) && !defined(RM_DEFERRED_PASS)
+// Depth of the meshes drawn before ray marching (of window resolution) and inverse of their view projection
+layout(binding = 1) uniform sampler2D raster_depth;
+uniform mat4 raster_inv_view_proj;
+#endif
 
 /*****
  * Globals
@@ -21,8 +102,12 @@ uniform vec3 bulb_color;
 
 float max_dist = 20; // max ray traversal distance
 float eps = 0.001;
+float reprojection_margin = 0.1; // ray starts this distance before the reprojected hit
+const int reprojection_checks = 16; // points of the skipped part of the ray tested against the previous frame
+const float smooth_k = RM_SMOOTH_K; // smooth union radius
 vec3 light_dir = normalize(vec3(1, 3, 3));
 vec3 lightColor = vec3(0.7);
+int steps = 0; // marching steps of the current invocation rays (stored only if 'RM_COUNT_STEPS' is defined for steps view)
 
 
 /*****
@@ -55,11 +140,24 @@ struct Box
     float radius;
 };
 
+struct Bound {
+    vec4 cen;
+    vec4 half_size;
+    float max_scale;
+};
+
 struct Surface {
     Material mtl;
     float sdf;
 };
 
+// Over-relaxed marching state ('omega' falls to 1 after the first step that could skip a surface)
+struct Relaxation {
+    float omega;
+    float dist; // distance at the start of the last step
+    float len;  // length of the last step
+};
+
 struct Twist {
     vec4 cen;
     vec4 dir;
@@ -72,6 +170,11 @@ struct Bend {
     vec4 rad;
 };
 
+struct Repeat {
+    vec4 period;
+    vec4 count;
+};
+
 /*****
  * SSBO's
  *****/
@@ -91,6 +194,18 @@ layout(binding = 4, std430) buffer MatricesBuffer
     mat4 matrices[];
 } matrices_buffer;
 
+// Inverted (and pre-multiplied for consecutive transformations) matrices, not inverted ones set frames of bendings
+layout(binding = 8, std430) buffer InverseMatricesBuffer
+{
+    mat4 matrices[];
+} inverse_matrices_buffer;
+
+// World space bounding boxes of guarded figures
+layout(binding = 9, std430) buffer BoundsBuffer
+{
+    Bound bounds[];
+} bounds_buffer;
+
 layout(binding = 5, std430) buffer TwistBuffer
 {
     Twist twists[];
@@ -101,6 +216,61 @@ layout(binding = 6, std430) buffer BendBuffer
     Bend bends[];
 } bend_buffer;
 
+layout(binding = 10, std430) buffer RepeatBuffer
+{
+    Repeat repeats[];
+} repeat_buffer;
+
+// Boxes swept by figures moved since the previous frame
+layout(binding = 13, std430) buffer MotionBoundsBuffer
+{
+    Bound bounds[];
+} motion_bounds_buffer;
+
+#ifdef RM_COMPUTE
+// World space bounding boxes of drawn figures (in order of 'SDF_figure_dist' cases)
+layout(binding = 12, std430) buffer FigureBoundsBuffer
+{
+    Bound bounds[];
+} figure_bounds_buffer;
+#endif
+
+// Marching steps of the frame pixels (steps view only)
+layout(binding = 14, std430) buffer StepsBuffer
+{
+    uint histogram[RM_STEPS_BINS]; // pixels by their steps (the last bin also counts greater ones)
+    uint pixel_steps[];
+} steps_buffer;
+
+// Lights are used by passes shading surfaces (deferred ones or tracing pass itself)
+#if !defined(RM_CONE_PREPASS)
+struct PointLight
+{
+    vec4 pos; // 'w' - radius of the light source surface (shadow rays end at it)
+    vec4 color; // 'w' - range
+};
+
+// Explicit point lights and lights of light source figures
+layout(binding = 15, std430) buffer LightBuffer
+{
+    PointLight lights[];
+} light_buffer;
+
+// Lights reaching every cell of the grid over the box of drawn figures (scene_min, scene_max),
+// lights of the cell are 'indices[offsets[cell]]'..'indices[offsets[cell + 1] - 1]'
+layout(binding = 16, std430) buffer LightClusterBuffer
+{
+    uint offsets[RM_LIGHT_GRID * RM_LIGHT_GRID * RM_LIGHT_GRID + 1];
+    uint indices[];
+} light_cluster_buffer;
+#endif
+
+// Lipschitz bounds of twisted and bent figures
+layout(binding = 11, std430) buffer LipschitzBuffer
+{
+    float lipschitz[];
+} lipschitz_buffer;
+
 /*****
  * SDF's
  *****/
@@ -109,7 +279,7 @@ Surface smin(Surface a, Surface b)
 {
     //float k = 0.1; // for ex 5
     //float k = 0.8; // for ex 1
-    float k = 0.7; // for ex 6
+    float k = smooth_k; // 0.7 for ex 6
     float h = clamp( 0.5+0.5*(b.sdf-a.sdf)/k, 0.0, 1.0 );
     Surface res;
     res.sdf = mix( b.sdf, a.sdf, h ) - k*h*(1.0-h);
@@ -165,6 +335,35 @@ Surface sub( Surface a, Surface b )
     return res;
 }
 
+// Distance only variants of operations (for SDF_dist)
+float sunite(float a, float b)
+{
+    float h = clamp(0.5 + 0.5 * (b - a) / smooth_k, 0.0, 1.0);
+    return mix(b, a, h) - smooth_k * h * (1.0 - h);
+}
+
+float unite(float a, float b)
+{
+    return min(a, b);
+}
+
+float inter(float a, float b)
+{
+    return max(a, b);
+}
+
+float sub(float a, float b)
+{
+    return max(a, -b);
+}
+
+// Signed distance to the bounding box (not greater than sdf of the bounded figure)
+float bound_dist(vec3 p, Bound b)
+{
+    vec3 q = abs(p - b.cen.xyz) - b.half_size.xyz;
+    return (length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0)) / b.max_scale;
+}
+
 Surface SDF_sphere(vec4 p, Sphere sphere)
 {
     vec3 pos = p.xyz;
@@ -188,6 +387,17 @@ Surface SDF_box(vec4 p, Box box)
     return res;
 }
 
+float dist_sphere(vec4 p, Sphere sphere)
+{
+    return length(p.xyz) - sphere.radius;
+}
+
+float dist_box(vec4 p, Box box)
+{
+    vec3 q = abs(p.xyz) - vec3(box.radius / 2);
+    return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
 vec3 c_ = vec3(cos(time) * 4, 2 * sin(time), 0 );
 vec3 dir_ = vec3(0, 0, 1);
 vec3 rad_ = normalize(-c_);//normalize(vec3(0, 0, -1));
@@ -228,8 +438,142 @@ vec4 twist(vec4 p, mat4 matr, Twist tw) {
     return m * p;
 }
 
+// Scale distance of deformed figure down to keep steps inside of it
+Surface lipschitz_scale(Surface s, float lipschitz) {
+    s.sdf /= lipschitz;
+    return s;
+}
+
+float lipschitz_scale(float d, float lipschitz) {
+    return d / lipschitz;
+}
+
+// Center of the repetition cell nearest to p (or of its neighbour towards p along axes where 'neighbour' is 1)
+vec3 repeat_cell(vec4 p, Repeat rep, vec3 neighbour) {
+    vec3 shift = (rep.count.xyz - 1) / 2;
+    vec3 q = p.xyz / rep.period.xyz + shift;
+    vec3 id = clamp(round(q), vec3(0), rep.count.xyz - 1);
+    id = clamp(id + neighbour * sign(q - id), vec3(0), rep.count.xyz - 1);
+    return (id - shift) * rep.period.xyz;
+}
+
 #include SDF_scene
 
+#ifdef SDF_BYTECODE
+/*****
+ * SDF bytecode interpreter
+ *****/
+
+// Opcodes 'OP_*' are defined by 'RMRender::getSharedDefines' ('RMOpcode' enum)
+
+struct Instruction {
+    int opcode;
+    int index;
+};
+
+layout(binding = 7, std430) buffer ProgramBuffer
+{
+    Instruction code[];
+} program_buffer;
+
+Surface SDF_scene(vec3 p)
+{
+    vec4 pos = vec4(p.xyz, 1);
+    mat4 matr = mat4(1), bend_matr = mat4(1);
+    vec4 pos_stack[SDF_STACK_SIZE];
+    mat4 matr_stack[SDF_STACK_SIZE];
+    Surface stack[SDF_STACK_SIZE];
+    int pos_top = 0, top = 0;
+
+    for (int pc = 0; ; pc++) {
+        Instruction instr = program_buffer.code[pc];
+        if (instr.opcode == OP_END) {
+            break;
+        } else if (instr.opcode == OP_PUSH_POS) {
+            pos_stack[pos_top] = pos;
+            matr_stack[pos_top++] = matr;
+        } else if (instr.opcode == OP_POP_POS) {
+            pos = pos_stack[--pos_top];
+            matr = matr_stack[pos_top];
+        } else if (instr.opcode == OP_MATRIX) {
+            mat4 inv = inverse_matrices_buffer.matrices[instr.index];
+            pos = inv * pos;
+            matr = inv * matr;
+        } else if (instr.opcode == OP_TWIST) {
+            pos = twist(pos, matr, twist_buffer.twists[instr.index]);
+        } else if (instr.opcode == OP_BEND) {
+            pos = bend(pos, bend_matr, bend_buffer.bends[instr.index]);
+            bend_matr = mat4(1);
+        } else if (instr.opcode == OP_BEND_MATRIX) {
+            bend_matr = inverse_matrices_buffer.matrices[instr.index];
+        } else if (instr.opcode == OP_REPEAT) {
+            // index - repeat id * 8 + neighbour cell bits
+            vec3 neighbour = vec3(instr.index & 1, (instr.index >> 1) & 1, (instr.index >> 2) & 1);
+            vec3 cell = repeat_cell(pos, repeat_buffer.repeats[instr.index >> 3], neighbour);
+            pos = vec4(pos.xyz - cell, pos.w);
+            matr = mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -cell, 1) * matr;
+        } else if (instr.opcode == OP_LIPSCHITZ) {
+            stack[top - 1] = lipschitz_scale(stack[top - 1], lipschitz_buffer.lipschitz[instr.index]);
+        } else if (instr.opcode == OP_SPHERE) {
+            stack[top++] = SDF_sphere(pos, sphere_buffer.spheres[instr.index]);
+        } else if (instr.opcode == OP_BOX) {
+            stack[top++] = SDF_box(pos, box_buffer.boxes[instr.index]);
+        } else {
+            Surface b = stack[--top];
+            Surface a = stack[top - 1];
+            if (instr.opcode == OP_UNION) {
+                stack[top - 1] = unite(a, b);
+            } else if (instr.opcode == OP_SUNION) {
+                stack[top - 1] = sunite(a, b);
+            } else if (instr.opcode == OP_INTERSECTION) {
+                stack[top - 1] = inter(a, b);
+            } else if (instr.opcode == OP_SUBTRACTION) {
+                stack[top - 1] = sub(a, b);
+            }
+        }
+    }
+
+    if (top == 0) {
+        Surface res;
+        res.sdf = max_dist;
+        res.mtl.color = vec4(0);
+        res.mtl.is_light_source = 0;
+        return res;
+    }
+    return stack[0];
+}
+
+// Interpreter has no distance only variant
+float SDF_dist(vec3 p)
+{
+    return SDF_scene(p).sdf;
+}
+#endif // SDF_BYTECODE
+
+#ifdef RM_COMPUTE
+// Drawn figures which bounds intersect the frustum of the current tile
+shared int tile_figures[RM_MAX_TILE_FIGURES];
+shared int tile_figures_count;
+
+// Distance to figures of the tile (pixel rays can't hit other figures)
+float primary_dist(vec3 p)
+{
+    if (tile_figures_count > RM_MAX_TILE_FIGURES) {
+        return SDF_dist(p);
+    }
+    float res = max_dist;
+    for (int i = 0; i < tile_figures_count; i++) {
+        res = min(res, SDF_figure_dist(tile_figures[i], p));
+    }
+    return res;
+}
+#else
+float primary_dist(vec3 p)
+{
+    return SDF_dist(p);
+}
+#endif
+
 /*****
  * Utils
  *****/
@@ -238,24 +582,70 @@ vec3 get_norm(vec3 pos)
 {
     vec2 step = vec2(eps, 0);
     vec3 norm;
-    norm.x += SDF_scene(pos + step.xyy).sdf - SDF_scene(pos - step.xyy).sdf;
-    norm.y += SDF_scene(pos + step.yxy).sdf - SDF_scene(pos - step.yxy).sdf;
-    norm.z += SDF_scene(pos + step.yyx).sdf - SDF_scene(pos - step.yyx).sdf;
+    norm.x = SDF_dist(pos + step.xyy) - SDF_dist(pos - step.xyy);
+    norm.y = SDF_dist(pos + step.yxy) - SDF_dist(pos - step.yxy);
+    norm.z = SDF_dist(pos + step.yyx) - SDF_dist(pos - step.yyx);
 
     return normalize(norm);
 }
 
+Relaxation start_relaxation()
+{
+    return Relaxation(relaxation, 0, 0);
+}
+
+// Check that the last step skipped no surfaces ('dist' - distance at its end), otherwise it is shortened to the safe one
+// ('margin' - doubled distance to surfaces that the step must keep)
+bool is_step_valid(inout Relaxation rx, float dist, inout float t, float margin)
+{
+    // Unbounding spheres of the step ends must overlap
+    if (rx.omega > 1 && dist + rx.dist - rx.len < margin) {
+        t += rx.dist - rx.len;
+        rx.omega = 1;
+        return false;
+    }
+    return true;
+}
+
+// Get the next step by distance 'dist' at 't' (step to 'end' and farther is not relaxed, as its end is not checked)
+float get_step(inout Relaxation rx, float dist, float t, float end)
+{
+    rx.dist = dist;
+    rx.len = t + dist * rx.omega < end ? dist * rx.omega : dist;
+    return rx.len;
+}
+
+// Part of the ray inside the scene box expanded by 'margin' ('x' exceeds 'y' if the box is missed), whole ray if clipping is disabled
+vec2 get_scene_interval(vec3 org, vec3 dir, float margin)
+{
+#ifdef RM_USE_SCENE_CLIPPING
+    vec3 t0 = (scene_min - margin - org) / dir, t1 = (scene_max + margin - org) / dir;
+    vec3 t_min = min(t0, t1), t_max = max(t0, t1);
+    return vec2(max(max(max(t_min.x, t_min.y), t_min.z), 0), min(min(t_max.x, t_max.y), t_max.z));
+#else
+    return vec2(0, 1e30);
+#endif
+}
+
 float softshadow( in vec3 ro, in vec3 rd, float mint, float maxt, float k )
 {
     float res = 1.0;
-    float t = mint;
-    for( int i=0; i < 256 && t<maxt; i++ )
+    // Penumbra is not changed by points farther than 'maxt / k' from surfaces
+    vec2 interval = get_scene_interval(ro, rd, maxt / k);
+    float t = max(mint, interval.x);
+    maxt = min(maxt, interval.y);
+    Relaxation rx = start_relaxation();
+    for( int i=0; i < max_steps && t<maxt; i++ )
     {
-        float h = SDF_scene(ro + rd*t).sdf;
+        float h = SDF_dist(ro + rd*t);
+        steps++;
+        // Skipped points must not be darker than penumbra found already
+        if( !is_step_valid(rx, h, t, 2*res*t/k) )
+        continue;
         if( h<0.001 )
         return 0.0;
         res = min( res, k*h/t );
-        t += h;
+        t += get_step(rx, h, t, maxt);
     }
     return res;
 }
@@ -264,33 +654,46 @@ float bulblight( in vec3 ro, float mint, float maxt, float k )
 {
     vec3 rd = normalize(bulb_pos - ro);
     float res = 1.0;
-    float t = mint;
-    for( int i=0; i < 256 && t<maxt; i++ )
+    vec2 interval = get_scene_interval(ro, rd, 0);
+    float t = max(mint, interval.x);
+    maxt = min(maxt, interval.y);
+    Relaxation rx = start_relaxation();
+    for( int i=0; i < max_steps && t<maxt; i++ )
     {
-        Surface srf = SDF_scene(ro + rd*t);
-        if (srf.sdf < 0.001) {
-            if (srf.mtl.is_light_source == 1) {
+        float d = SDF_dist(ro + rd*t);
+        steps++;
+        if (!is_step_valid(rx, d, t, 0)) {
+            continue;
+        }
+        if (d < 0.001) {
+            if (SDF_scene(ro + rd*t).mtl.is_light_source == 1) {
                 return exp(1 - t);
             }
             return 0;
         }
-        t += srf.sdf;
+        t += get_step(rx, d, t, maxt);
     }
     return 0;
 }
 Material reflection(vec3 org, vec3 dir) {
-    float t = 0;
-    while (t < max_dist)
+    vec2 interval = get_scene_interval(org, dir, 0);
+    float t = interval.x, end = min(interval.y, max_dist);
+    Relaxation rx = start_relaxation();
+    for (int i = 0; i < max_steps && t < end; i++)
     {
         vec3 pos = org + dir * t;
         vec3 c = vec3(1, 1, 1);
-        Surface srf = SDF_scene(pos);
+        float d = SDF_dist(pos);
+        steps++;
+        if (!is_step_valid(rx, d, t, 0)) {
+            continue;
+        }
 
-        if (srf.sdf < eps)
+        if (d < eps)
         {
-            return srf.mtl;
+            return SDF_scene(pos).mtl;
         }
-        t += srf.sdf;
+        t += get_step(rx, d, t, end);
     }
     Material res;
     res.color = vec4(0, 0, 0, 1);
@@ -303,7 +706,8 @@ float AmbientOc( vec3 Org, vec3 Dir, float tmax, float s )
 
     while (t < tmax)
     {
-        d = SDF_scene(Org + Dir * t * dt).sdf;
+        d = SDF_dist(Org + Dir * t * dt);
+        steps++;
         oc += (1 / pow(2, t)) * (t * dt - d);
         t++;
     }
@@ -329,57 +733,520 @@ vec3 lightResponse(vec3 vertexPosition, vec3 vertexNormal, vec3 vertexColor) {
     return pointNaturalColor * diffuse;
 }
 
-Material trace(vec3 org, vec3 dir)
+// Secondary effects of the surface point seen along 'dir': reflection color and occlusion by shadow and ambient one ('w')
+vec4 get_effects(vec3 pos, vec3 nrm, vec3 dir)
 {
-    float t = 0;
-    while (t < max_dist)
+    float shd = softshadow(pos + nrm * 0.2, light_dir, 0.1, 10, 10);
+    float occlusion = min(max(AmbientOc(pos, nrm, 5, 0.3), 0.7), 1) * min(max(shd, 0.7), 1);
+    Material rf = reflection(pos + nrm * 0.1, reflect(dir, nrm));
+    return vec4(rf.color.rgb, occlusion);
+}
+
+// Light of the bulb at the surface point
+float get_bulb_light(vec3 pos, vec3 nrm)
+{
+    return bulblight(pos + nrm * 0.1, 0, 10, 20);
+}
+
+// Attenuation of the surface color by distance 't' from the near plane
+float get_attenuation(float t)
+{
+    return max(pow(t, 1.6), 25) / 20;
+}
+
+#if !defined(RM_CONE_PREPASS)
+// Light of the point lights reaching the cell of the surface point (each one is shadowed by figures)
+vec3 get_point_light(vec3 pos, vec3 nrm, vec3 color)
+{
+    vec3 res = vec3(0);
+#ifdef RM_USE_POINT_LIGHTS
+    ivec3 cell = clamp(ivec3(floor((pos - scene_min) / (scene_max - scene_min) * RM_LIGHT_GRID)), ivec3(0), ivec3(RM_LIGHT_GRID - 1));
+    int index = (cell.z * RM_LIGHT_GRID + cell.y) * RM_LIGHT_GRID + cell.x;
+    for (uint i = light_cluster_buffer.offsets[index]; i < light_cluster_buffer.offsets[index + 1]; i++) {
+        PointLight light = light_buffer.lights[light_cluster_buffer.indices[i]];
+        vec3 dir = light.pos.xyz - pos;
+        float dist = length(dir);
+        dir /= dist;
+        // Inverse square falloff smoothly ends at the light range
+        float window = max(1 - dist * dist / (light.color.w * light.color.w), 0);
+        float diffuse = dot(nrm, dir) * window * window / (1 + dist * dist);
+        if (diffuse <= 0) {
+            continue;
+        }
+        // Shadow ray stops short of the source surface (it would darken penumbra near the source otherwise)
+        vec3 ro = pos + nrm * 0.1;
+        vec3 rd = light.pos.xyz - ro;
+        float len = length(rd);
+        float k = 16;
+        res += color * light.color.rgb * diffuse * softshadow(ro, rd / len, 0.05, len - light.pos.w - len / k, k);
+    }
+#endif
+    return res;
+}
+#endif
+
+// 't' - start distance, becomes the hit one (or 'max_dist' if there is no hit before 'end' in 'max_steps'), 'nrm' - normal at the hit
+Material trace(vec3 org, vec3 dir, inout float t, float end, out vec3 nrm)
+{
+    nrm = vec3(0);
+    end = min(end, max_dist);
+    Relaxation rx = start_relaxation();
+    for (int i = 0; i < max_steps && t < end; i++)
     {
         vec3 pos = org + dir * t;
-        vec3 c = vec3(1, 1, 1);
-        Surface srf = SDF_scene(pos);
+        float d = primary_dist(pos);
+        steps++;
+        if (!is_step_valid(rx, d, t, 0)) {
+            continue;
+        }
 
-        if (srf.sdf < eps)
+        if (d < eps)
         {
-            //res = average_mtl(pos);
-            //srf.mtl.color = vec4(1, 0, 0, 1);
-            //srf.mtl.color *= 0.4 * abs(dot(light_dir, get_norm(pos, -dir))) + 0.4;
-            vec3 nrm = get_norm(pos);
-            //srf.mtl.color = vec4(lightResponse(pos, nrm, vec3(1, 0, 0)) * depth, 1);
-            //srf.mtl.color = vec4(nrm.xyz, 1);
-            //srf.mtl.color = vec4(get_norm(pos, -dir), 1);
-            //srf.mtl.color = vec4(1, 0, 0, 1);
-            //res.color = vec4(1, 0, 0, 1);
-            //srf.mtl.color += rf.color * 0.1;
-            //srf.mtl.color *= min(max(shd, 0.6), 1);
-            //srf.mtl.color = vec4(nrm, 1);
-            //srf.mtl.color = vec4(lightResponse(pos, nrm, srf.mtl.color.xyz) * depth, 1);
-            if (srf.mtl.is_light_source == 0) {
-                float shd = softshadow(pos + nrm * 0.2, light_dir, 0.1, 10, 10);
-                srf.mtl.color = vec4(lightResponse(pos, nrm, srf.mtl.color.xyz), 1);
-                srf.mtl.color *= min(max(AmbientOc(pos, nrm, 5, 0.3), 0.7), 1);
-                srf.mtl.color *= min(max(shd, 0.7), 1);
-
-                Material rf = reflection(pos + nrm * 0.1, reflect(dir, nrm));
-                srf.mtl.color = srf.mtl.color * 0.9 + rf.color * 0.1;
-                srf.mtl.color /= max(pow(t, 1.6), 25) / 20;
-                if (is_bulb == 1) {
-                    float lgh = bulblight(pos + nrm * 0.1, 0, 10, 20);
-                    srf.mtl.color += vec4(bulb_color, 1) * lgh * 0.3;
-                }
-                //srf.mtl.color = vec4(nrm, 1);
-            }
-
-
-            return srf.mtl;
+            // Material and normal are evaluated only once, at the hit point (surface is lit by the caller)
+            nrm = get_norm(pos);
+            return SDF_scene(pos).mtl;
         }
-        t += srf.sdf;
+        t += get_step(rx, d, t, end);
     }
+    t = max_dist;
     Material res;
     res.color = vec4(vec3(0) / 255, 1);
+    res.is_light_source = 0;
     return res;
 }
 
+// Position of the pixel (by its window coordinates) on the near plane relative to camera
+vec3 get_pixel_pos(vec2 coord)
+{
+    float near = 1;
+    coord += vec2(jitter_x, jitter_y);
+    return cam_dir * near + normalize(cam_up) * ((coord.y / frame_h) - 0.5) +
+    normalize(cam_right) * ((coord.x / frame_w) - 0.5);
+}
+
+#if !defined(RM_CONE_PREPASS) && !defined(RM_DEFERRED_PASS)
+// Distance along the ray to the box entry ('max_dist' if the box is missed)
+float get_box_entry(vec3 org, vec3 dir, Bound b)
+{
+    vec3 t0 = (b.cen.xyz - b.half_size.xyz - org) / dir, t1 = (b.cen.xyz + b.half_size.xyz - org) / dir;
+    vec3 t_min = min(t0, t1), t_max = max(t0, t1);
+    float t_near = max(max(t_min.x, t_min.y), t_min.z), t_far = min(min(t_max.x, t_max.y), t_max.z);
+    return t_near <= t_far && t_far >= 0 ? t_near : max_dist;
+}
+
+// Check if the point was in front of surfaces seen by the previous frame (the space there is known to be empty)
+bool is_prev_empty(vec3 pos)
+{
+    vec3 v = pos - prev_cam_pos;
+    float z = dot(v, prev_cam_dir) / dot(prev_cam_dir, prev_cam_dir);
+    if (z <= 0) {
+        return false;
+    }
+    v /= z;
+    // Border of the previous frame is also excluded (neighbours are unknown there)
+    vec2 coord = (vec2(dot(v, normalize(prev_cam_right)), dot(v, normalize(prev_cam_up))) + 0.5) * vec2(frame_w, frame_h);
+    if (any(lessThan(coord, vec2(2))) || any(greaterThanEqual(coord, vec2(frame_w, frame_h) - 2))) {
+        return false;
+    }
+    // Nearest of the surrounding hits is taken to not pass through edges of surfaces
+    float dist = length(pos - prev_cam_pos);
+    ivec2 base = ivec2(floor(coord - 0.5));
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            float hit = imageLoad(prev_history_image, base + ivec2(x, y)).r;
+            if (hit > 0 && dist >= hit) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Distance from camera to the farthest mesh seen by window pixels of the pixel ('max_dist' if some see none)
+float get_raster_dist(ivec2 pixel)
+{
+    ivec2 size = textureSize(raster_depth, 0);
+    vec2 scale = vec2(size) / vec2(frame_w, frame_h);
+    ivec2 p0 = min(ivec2(vec2(pixel) * scale), size - 1), p1 = max(min(ivec2(ceil(vec2(pixel + 1) * scale)), size), p0 + 1);
+    float res = 0;
+    for (int y = p0.y; y < p1.y; y++) {
+        for (int x = p0.x; x < p1.x; x++) {
+            float depth = texelFetch(raster_depth, ivec2(x, y), 0).r;
+            if (depth >= 1) {
+                return max_dist;
+            }
+            vec4 pos = raster_inv_view_proj * vec4((vec2(x, y) + 0.5) / vec2(size) * 2 - 1, depth * 2 - 1, 1);
+            res = max(res, length(pos.xyz / pos.w - cam_pos));
+        }
+    }
+    return res;
+}
 
+// Part of the pixel ray (from the near plane) inside proxy boxes of drawn figures and in front of meshes (if the features are enabled)
+vec2 get_proxy_interval(ivec2 pixel, vec3 pixel_pos)
+{
+#ifdef RM_USE_PROXIES
+    vec2 interval = imageLoad(proxy_image, pixel).rg * vec2(1, -1);
+#else
+    vec2 interval = vec2(length(pixel_pos), max_dist);
+#endif
+#ifdef RM_USE_RASTER_DEPTH
+    // Depth of background pixels is not needed
+    if (interval.x < max_dist) {
+        interval.y = min(interval.y, get_raster_dist(pixel));
+    }
+#endif
+    return interval - length(pixel_pos);
+}
+
+// Distance along the pixel ray (from the near plane) where tracing may start
+float get_start_dist(ivec2 pixel, vec3 pixel_pos)
+{
+#ifdef RM_USE_CONE_PREPASS
+    float t = max(imageLoad(start_image, pixel / RM_CONE_BLOCK).r - length(pixel_pos), 0);
+#else
+    float t = 0;
+#endif
+#ifdef RM_USE_REPROJECTION
+    // Neighbours are taken to not skip foreground near its edges
+    uint bits = 0xFFFFFFFFu;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 p = clamp(pixel + ivec2(x, y), ivec2(0), ivec2(frame_w - 1, frame_h - 1));
+            bits = min(bits, imageLoad(hint_image, p).r);
+        }
+    }
+    float hint = uintBitsToFloat(bits);
+    if (hint >= max_dist) {
+        return t;
+    }
+    vec3 dir = normalize(pixel_pos);
+    float dist = hint - length(pixel_pos) - reprojection_margin;
+    // Moved figures could be anywhere inside their swept boxes
+    for (int i = 0; i < motion_bounds_buffer.bounds.length(); i++) {
+        dist = min(dist, get_box_entry(cam_pos + pixel_pos, dir, motion_bounds_buffer.bounds[i]));
+    }
+    // Skipped part of the ray should be seen empty by previous frame (hint may come from a surface behind a hole)
+    for (int i = 0; i < reprojection_checks && dist > t; i++) {
+        if (!is_prev_empty(cam_pos + pixel_pos + dir * mix(t, dist, float(i) / reprojection_checks))) {
+            return t;
+        }
+    }
+    // Hint overshoots if its start is inside a surface
+    if (dist > t && SDF_dist(cam_pos + pixel_pos + dir * dist) > 0) {
+        return dist;
+    }
+#endif
+    return t;
+}
+
+#if !defined(RM_USE_DEFERRED)
+// Color of the surface point at distance 't' along the pixel ray (direct light, secondary effects and lights at once)
+vec3 get_hit_color(vec3 pos, vec3 nrm, vec3 dir, float t, vec3 color)
+{
+    vec3 res = lightResponse(pos, nrm, color) / get_attenuation(t);
+    if (is_simple_shading == 0) {
+        vec4 effects = get_effects(pos, nrm, dir);
+        res = res * effects.w * 0.9 + effects.rgb * 0.1 / get_attenuation(t);
+    }
+    if (is_bulb == 1) {
+        res += bulb_color * get_bulb_light(pos, nrm) * 0.3;
+    }
+    // Point lights are added after occlusion (main light shadow does not darken them)
+    return res + get_point_light(pos, nrm, color);
+}
+#endif
+
+// Store G-buffer of the pixel (or its shaded color if shading is not deferred)
+void store_hit(ivec2 pixel, vec3 pixel_pos, float t, Material mtl, vec3 nrm)
+{
+    float dist = t < max_dist ? t + length(pixel_pos) : 0;
+#if defined(RM_USE_DEFERRED)
+    vec4 normal = vec4(nrm, dist > 0 && mtl.is_light_source == 0 ? 1 : 0);
+    vec4 material = vec4(mtl.color.rgb, mtl.is_light_source);
+#else
+    // Background and light sources keep their color
+    vec3 dir = normalize(pixel_pos);
+    vec4 color = vec4(dist > 0 && mtl.is_light_source == 0 ? get_hit_color(cam_pos + pixel_pos + dir * t, nrm, dir, t, mtl.color.rgb) : mtl.color.rgb, 1);
+#endif
+#ifdef RM_COUNT_STEPS
+    // Steps of the secondary rays are added by deferred passes (unless they are traced here already)
+    steps_buffer.pixel_steps[pixel.y * frame_w + pixel.x] = steps;
+#endif
+#if defined(RM_COMPUTE)
+    imageStore(history_image, pixel, vec4(dist));
+#if defined(RM_USE_DEFERRED)
+    imageStore(normal_image, pixel, normal);
+    imageStore(material_image, pixel, material);
+#else
+    imageStore(frame_image, pixel, color);
+#endif
+#else
+    out_dist = dist;
+#if defined(RM_USE_DEFERRED)
+    out_normal = normal;
+    out_material = material;
+#else
+    out_color = color;
+#endif
+#endif
+}
+#endif
+
+#ifdef RM_DEFERRED_PASS
+const float upsample_plane_tolerance = 0.02; // distance (relative to depth) of samples from the surface plane
+const float upsample_normal_tolerance = 0.8; // min cosine between normals of samples of the same surface
+
+// Frame pixel whose surface is sampled by the secondary pass pixel (middle of the covered block)
+ivec2 get_sample_pixel(ivec2 cell)
+{
+    return min(cell * secondary_scale + secondary_scale / 2, ivec2(frame_w, frame_h) - 1);
+}
+
+// Position of the surface seen by the frame pixel
+vec3 get_surface_pos(ivec2 pixel)
+{
+    return cam_pos + normalize(get_pixel_pos(vec2(pixel) + 0.5)) * imageLoad(history_image, pixel).r;
+}
+
+// Secondary effects of the lit frame pixel (reflection color and occlusion) and bulb light
+vec4 get_pixel_effects(ivec2 pixel, vec3 nrm, out float bulb_light)
+{
+    vec3 pos = get_surface_pos(pixel);
+    bulb_light = is_bulb == 1 ? get_bulb_light(pos, nrm) : 0;
+    return get_effects(pos, nrm, normalize(get_pixel_pos(vec2(pixel) + 0.5)));
+}
+
+// Add steps of the invocation rays to every frame pixel of the block shaded by them (steps view only)
+void add_pixel_steps(ivec2 block_min, int size)
+{
+#ifdef RM_COUNT_STEPS
+    if (steps == 0) {
+        return;
+    }
+    ivec2 block_max = min(block_min + size, ivec2(frame_w, frame_h));
+    for (int y = block_min.y; y < block_max.y; y++) {
+        for (int x = block_min.x; x < block_max.x; x++) {
+            steps_buffer.pixel_steps[y * frame_w + x] += steps;
+        }
+    }
+#endif
+}
+#endif
+
+#if defined(RM_CONE_PREPASS)
+const int cone_max_steps = 64;
+
+// Main shader program function: march one cone per block of pixels and store distance from camera free of surfaces
+void main() {
+    ivec2 block = ivec2(gl_GlobalInvocationID.xy);
+    if (block.x * RM_CONE_BLOCK >= frame_w || block.y * RM_CONE_BLOCK >= frame_h) {
+        return;
+    }
+    vec2 block_min = vec2(block * RM_CONE_BLOCK), block_max = block_min + RM_CONE_BLOCK;
+    vec3 axis = normalize(get_pixel_pos((block_min + block_max) / 2));
+    vec3 corners[4] = vec3[4](
+        get_pixel_pos(block_min), get_pixel_pos(vec2(block_max.x, block_min.y)),
+        get_pixel_pos(block_max), get_pixel_pos(vec2(block_min.x, block_max.y))
+    );
+    // Tangent of the cone half angle (cone contains rays of all block pixels)
+    float k = 0;
+    for (int i = 0; i < 4; i++) {
+        vec3 c = normalize(corners[i]);
+        k = max(k, length(cross(axis, c)) / dot(axis, c));
+    }
+
+    // Distance along the axis from camera, rays start at the near plane or at the nearest proxy box entry
+    float s = 1;
+#ifdef RM_USE_PROXIES
+    s = max_dist;
+    for (int y = 0; y < RM_CONE_BLOCK; y++) {
+        for (int x = 0; x < RM_CONE_BLOCK; x++) {
+            ivec2 p = min(block * RM_CONE_BLOCK + ivec2(x, y), ivec2(frame_w - 1, frame_h - 1));
+            s = min(s, imageLoad(proxy_image, p).r);
+        }
+    }
+    // Blocks of background only are not marched
+    s = max(s, 1);
+#endif
+    for (int i = 0; i < cone_max_steps && s < max_dist; i++) {
+        float d = SDF_dist(cam_pos + axis * s);
+        float r = k * s;
+        if (d < r + eps) {
+            break;
+        }
+        // Ball of radius 'd' still covers the whole cone section after the step
+        s += (d - r) / (1 + k);
+    }
+    imageStore(start_image, block, vec4(s));
+} // End of 'main' function
+#elif defined(RM_LIGHTING)
+// Main shader program function: light surfaces of the G-buffer by direct light
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= frame_w || pixel.y >= frame_h) {
+        return;
+    }
+    vec4 nrm = imageLoad(normal_image, pixel);
+    vec4 mtl = imageLoad(material_image, pixel);
+    // Background and light sources keep their color
+    if (nrm.w == 0) {
+        imageStore(frame_image, pixel, vec4(mtl.rgb, 1));
+        return;
+    }
+    nrm.xyz = normalize(nrm.xyz);
+    vec3 pos = get_surface_pos(pixel);
+    float t = length(pos - cam_pos) - length(get_pixel_pos(vec2(pixel) + 0.5));
+    vec3 color = lightResponse(pos, nrm.xyz, mtl.rgb) / get_attenuation(t);
+    // Secondary passes are skipped in simple shading, bulb and point lights are kept
+    if (is_simple_shading == 1) {
+        if (is_bulb == 1) {
+            color += bulb_color * get_bulb_light(pos, nrm.xyz) * 0.3;
+        }
+        color += get_point_light(pos, nrm.xyz, mtl.rgb);
+        add_pixel_steps(pixel, 1);
+    }
+    imageStore(frame_image, pixel, vec4(color, 1));
+} // End of 'main' function
+#elif defined(RM_SECONDARY)
+// Main shader program function: trace secondary effects of one pixel of each block of frame pixels
+void main() {
+    ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+    if (cell.x * secondary_scale >= frame_w || cell.y * secondary_scale >= frame_h) {
+        return;
+    }
+    ivec2 pixel = get_sample_pixel(cell);
+    vec4 nrm = imageLoad(normal_image, pixel);
+    if (nrm.w == 0) {
+        imageStore(effects_image, cell, vec4(0, 0, 0, -1));
+        return;
+    }
+    float bulb_light;
+    imageStore(effects_image, cell, get_pixel_effects(pixel, normalize(nrm.xyz), bulb_light));
+    imageStore(bulb_light_image, cell, vec4(bulb_light));
+    // Effects of the sample are upsampled to the whole block
+    add_pixel_steps(cell * secondary_scale, secondary_scale);
+} // End of 'main' function
+#elif defined(RM_COMPOSITE)
+// Main shader program function: add secondary effects upsampled from samples of the same surface to the frame
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= frame_w || pixel.y >= frame_h) {
+        return;
+    }
+    vec4 nrm = imageLoad(normal_image, pixel);
+    // Background and light sources are final
+    if (nrm.w == 0) {
+        return;
+    }
+    nrm.xyz = normalize(nrm.xyz);
+    vec3 pos = get_surface_pos(pixel);
+    float dist = length(pos - cam_pos);
+
+    // Joint bilateral weights of the nearest secondary pass pixels (the pixel itself at full resolution)
+    ivec2 cells = (ivec2(frame_w, frame_h) + secondary_scale - 1) / secondary_scale;
+    vec2 cell_pos = (vec2(pixel) + 0.5) / secondary_scale - 0.5;
+    ivec2 base = ivec2(floor(cell_pos));
+    vec2 f = cell_pos - vec2(base);
+    vec4 effects = vec4(0);
+    float bulb_light = 0, weight = 0;
+    int size = secondary_scale > 1 ? 2 : 1;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            ivec2 cell = clamp(base + ivec2(x, y), ivec2(0), cells - 1);
+            vec4 e = imageLoad(effects_image, cell);
+            if (e.w < 0) {
+                continue;
+            }
+            ivec2 sample_pixel = get_sample_pixel(cell);
+            float plane_w = 1 - abs(dot(get_surface_pos(sample_pixel) - pos, nrm.xyz)) / (dist * upsample_plane_tolerance);
+            float normal_w = (dot(normalize(imageLoad(normal_image, sample_pixel).xyz), nrm.xyz) - upsample_normal_tolerance) / (1 - upsample_normal_tolerance);
+            vec2 bilinear = mix(1 - f, f, vec2(x, y));
+            float w = max(bilinear.x * bilinear.y, 0.01) * max(plane_w, 0) * max(normal_w, 0);
+            effects += e * w;
+            bulb_light += imageLoad(bulb_light_image, cell).r * w;
+            weight += w;
+        }
+    }
+    if (weight > 0) {
+        effects /= weight;
+        bulb_light /= weight;
+    } else {
+        // No samples of the same surface (edges and thin figures), traced at full resolution
+        effects = get_pixel_effects(pixel, nrm.xyz, bulb_light);
+    }
+    // Frame holds lit color already attenuated by distance
+    vec3 color = imageLoad(frame_image, pixel).rgb * effects.w * 0.9 + effects.rgb * 0.1 / get_attenuation(dist - length(get_pixel_pos(vec2(pixel) + 0.5)));
+    if (is_bulb == 1) {
+        color += bulb_color * bulb_light * 0.3;
+    }
+    // Point lights are added after occlusion (main light shadow does not darken them)
+    color += get_point_light(pos, nrm.xyz, imageLoad(material_image, pixel).rgb);
+    add_pixel_steps(pixel, 1);
+    imageStore(frame_image, pixel, vec4(color, 1));
+} // End of 'main' function
+#elif defined(RM_STEPS)
+// Main shader program function: show marching steps of the pixel as heatmap (log scale, blue - none, red - 'max_steps' and more) and count them
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= frame_w || pixel.y >= frame_h) {
+        return;
+    }
+    uint pixel_steps = steps_buffer.pixel_steps[pixel.y * frame_w + pixel.x];
+    atomicAdd(steps_buffer.histogram[min(pixel_steps, uint(RM_STEPS_BINS - 1))], 1);
+    float heat = min(log2(1 + float(pixel_steps)) / log2(1 + float(max_steps)), 1);
+    imageStore(frame_image, pixel, vec4(clamp(1.5 - abs(4 * heat - vec3(3, 2, 1)), 0, 1), 1));
+} // End of 'main' function
+#elif defined(RM_COMPUTE)
+// Check if box is outside of the pyramid from camera through the corners (counterclockwise)
+bool is_outside_tile(Bound b, vec3 corners[4])
+{
+    vec3 cen = b.cen.xyz - cam_pos;
+    for (int i = 0; i < 4; i++) {
+        vec3 n = cross(corners[(i + 1) % 4], corners[i]);
+        if (dot(n, cen) + dot(abs(n), b.half_size.xyz) < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Main shader program function
+void main() {
+    // Figures of the tile are collected by all invocations of the work group
+    if (gl_LocalInvocationIndex == 0) {
+        tile_figures_count = 0;
+    }
+    barrier();
+    vec2 tile_min = vec2(gl_WorkGroupID.xy * RM_TILE_SIZE), tile_max = tile_min + RM_TILE_SIZE;
+    vec3 corners[4] = vec3[4](
+        get_pixel_pos(tile_min), get_pixel_pos(vec2(tile_max.x, tile_min.y)),
+        get_pixel_pos(tile_max), get_pixel_pos(vec2(tile_min.x, tile_max.y))
+    );
+    for (int i = int(gl_LocalInvocationIndex); i < figure_bounds_buffer.bounds.length(); i += RM_TILE_SIZE * RM_TILE_SIZE) {
+        if (!is_outside_tile(figure_bounds_buffer.bounds[i], corners)) {
+            int index = atomicAdd(tile_figures_count, 1);
+            if (index < RM_MAX_TILE_FIGURES) {
+                tile_figures[index] = i;
+            }
+        }
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= frame_w || pixel.y >= frame_h) {
+        return;
+    }
+    // Pixel center, as gl_FragCoord
+    vec3 pixel_pos = get_pixel_pos(vec2(pixel) + 0.5);
+    // Rays of background pixels (or hidden by meshes) are not traced
+    vec2 interval = get_proxy_interval(pixel, pixel_pos);
+    float t = interval.x < min(interval.y, max_dist) ? max(get_start_dist(pixel, pixel_pos), interval.x) : max_dist;
+    vec3 nrm;
+    Material mtl = trace(pixel_pos + cam_pos, normalize(pixel_pos), t, interval.y, nrm);
+    store_hit(pixel, pixel_pos, t, mtl, nrm);
+} // End of 'main' function
+#else
 // Main shader program function
 void main() {
     //outColor = vec4(inColor + vec3(1, 1, 1), 1);
@@ -393,9 +1260,7 @@ void main() {
     float near = 1;
     float far = 2000;
 
-    vec3 pixel_pos = (cam_dir * near +
-    normalize(cam_up) * ((float(gl_FragCoord.y) / frame_h) - 0.5) +
-    normalize(cam_right) * ((float(gl_FragCoord.x) / frame_w) - 0.5));
+    vec3 pixel_pos = get_pixel_pos(gl_FragCoord.xy);
 
     vec3 pixel_pos2 = pixel_pos * (far / near);
 
@@ -404,11 +1269,14 @@ void main() {
 
     float t = time * 2;
     //light_dir = normalize(2 * vec3(0, 1, 0) + vec3(sin(t), 0, cos(t)));
-    outColor = vec4(0);
 
     Material mtl;
-    mtl = trace(org, dir);
-    outColor = vec4(mtl.color);
+    // Rays of background pixels (or hidden by meshes) are not traced
+    vec2 interval = get_proxy_interval(ivec2(gl_FragCoord.xy), pixel_pos);
+    float start = interval.x < min(interval.y, max_dist) ? max(get_start_dist(ivec2(gl_FragCoord.xy), pixel_pos), interval.x) : max_dist;
+    vec3 nrm;
+    mtl = trace(org, dir, start, interval.y, nrm);
+    store_hit(ivec2(gl_FragCoord.xy), pixel_pos, start, mtl, nrm);
     //outColor = vec4(0 * float(gl_FragCoord.x) / frame_w, float(gl_FragCoord.y) / frame_h, 0, 1);
     int i = int(float(gl_FragCoord.x) / frame_w * 4);
     int j = 3 - int(float(gl_FragCoord.y) / frame_h * 4);
@@ -421,3 +1289,4 @@ void main() {
     //outColor = vec4(1, 0, 0, 1);
 
 } // End of 'main' function
+#endif // RM_CONE_PREPASS
@@ -0,0 +1,46 @@
+#version 460 core
+
+// Distances from camera to the nearest box entry and to the farthest box exit (negated), blended by min
+layout(location = 0) out vec2 out_interval;
+
+struct Bound {
+    vec4 cen;
+    vec4 half_size;
+    float max_scale;
+};
+
+// World space bounding boxes of drawn figures
+layout(binding = 12, std430) buffer FigureBoundsBuffer
+{
+    Bound bounds[];
+} figure_bounds_buffer;
+
+uniform int frame_w;
+uniform int frame_h;
+uniform float jitter_x;
+uniform float jitter_y;
+uniform vec3 cam_pos;
+uniform vec3 cam_dir;
+uniform vec3 cam_up;
+uniform vec3 cam_right;
+
+flat in int bound_index;
+
+// Main shader program function: intersect ray of the pixel center with the rasterized box
+void main() {
+    // Same as 'get_pixel_pos' of rm shader
+    vec2 coord = (gl_FragCoord.xy + vec2(jitter_x, jitter_y)) / vec2(frame_w, frame_h) - 0.5;
+    vec3 dir = normalize(cam_dir + normalize(cam_up) * coord.y + normalize(cam_right) * coord.x);
+
+    // Hit threshold of scaled or deformed figure is stretched up to 'max_scale' times
+    Bound b = figure_bounds_buffer.bounds[bound_index];
+    vec3 half_size = b.half_size.xyz + RM_PROXY_MARGIN * b.max_scale;
+    vec3 t0 = (b.cen.xyz - half_size - cam_pos) / dir, t1 = (b.cen.xyz + half_size - cam_pos) / dir;
+    vec3 t_min = min(t0, t1), t_max = max(t0, t1);
+    float t_near = max(max(t_min.x, t_min.y), t_min.z), t_far = min(min(t_max.x, t_max.y), t_max.z);
+    // Both box sides are rasterized, edges of the box silhouette may still miss
+    if (t_near > t_far || t_far < 0) {
+        discard;
+    }
+    out_interval = vec2(max(t_near, 0), -t_far);
+} // End of 'main' function
@@ -0,0 +1,45 @@
+#version 460 core
+
+struct Bound {
+    vec4 cen;
+    vec4 half_size;
+    float max_scale;
+};
+
+// World space bounding boxes of drawn figures (one instance per box)
+layout(binding = 12, std430) buffer FigureBoundsBuffer
+{
+    Bound bounds[];
+} figure_bounds_buffer;
+
+uniform vec3 cam_pos;
+uniform vec3 cam_dir;
+uniform vec3 cam_up;
+uniform vec3 cam_right;
+uniform int frame_w;
+uniform int frame_h;
+uniform float jitter_x;
+uniform float jitter_y;
+
+flat out int bound_index;
+
+// Corners (bits of the max sides) of the box triangles
+const int box_corners[36] = int[36](
+    0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,
+    0, 1, 5, 0, 5, 4,  2, 6, 7, 2, 7, 3,
+    0, 4, 6, 0, 6, 2,  1, 3, 7, 1, 7, 5
+);
+
+// Main shader program function: project box corner as rays of the rm shader pixels
+void main() {
+    Bound b = figure_bounds_buffer.bounds[gl_InstanceID];
+    int corner = box_corners[gl_VertexID];
+    vec3 side = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2 - 1;
+    vec3 v = b.cen.xyz + side * (b.half_size.xyz + RM_PROXY_MARGIN * b.max_scale) - cam_pos;
+    // Inverse of 'get_pixel_pos' of rm shader, clipped just in front of camera (rays start farther, at the near plane)
+    float z = dot(v, cam_dir) / dot(cam_dir, cam_dir);
+    // Jittered rays see the box shifted back by jitter (in pixels)
+    vec2 shift = vec2(jitter_x / frame_w, jitter_y / frame_h) * 2 * z;
+    gl_Position = vec4(dot(v, normalize(cam_right)) * 2 - shift.x, dot(v, normalize(cam_up)) * 2 - shift.y, z - 0.002, z);
+    bound_index = gl_InstanceID;
+} // End of 'main' function
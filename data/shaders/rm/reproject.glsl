@@ -0,0 +1,53 @@
+#version 460 core
+
+layout(local_size_x = RM_REPROJECT_GROUP_SIZE, local_size_y = RM_REPROJECT_GROUP_SIZE) in;
+
+// Hit distances of the previous frame and their min reprojected to the current one (float bits)
+layout(binding = 4, r32f) uniform readonly image2D prev_history_image;
+layout(binding = 3, r32ui) uniform uimage2D hint_image;
+
+uniform int frame_w;
+uniform int frame_h;
+uniform vec3 cam_pos;
+uniform vec3 cam_dir;
+uniform vec3 cam_up;
+uniform vec3 cam_right;
+uniform vec3 prev_cam_pos;
+uniform vec3 prev_cam_dir;
+uniform vec3 prev_cam_up;
+uniform vec3 prev_cam_right;
+
+// Main shader program function: move hit of every previous frame pixel to the current frame pixels
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= frame_w || pixel.y >= frame_h) {
+        return;
+    }
+    float dist = imageLoad(prev_history_image, pixel).r;
+    if (dist <= 0) {
+        return;
+    }
+    // Same as 'get_pixel_pos' of rm shader
+    vec2 coord = (vec2(pixel) + 0.5) / vec2(frame_w, frame_h) - 0.5;
+    vec3 pos = prev_cam_pos + normalize(prev_cam_dir + normalize(prev_cam_up) * coord.y + normalize(prev_cam_right) * coord.x) * dist;
+
+    vec3 v = pos - cam_pos;
+    float z = dot(v, cam_dir) / dot(cam_dir, cam_dir);
+    if (z <= 0) {
+        return;
+    }
+    v /= z;
+    coord = (vec2(dot(v, normalize(cam_right)), dot(v, normalize(cam_up))) + 0.5) * vec2(frame_w, frame_h);
+    uint hint = floatBitsToUint(length(pos - cam_pos));
+
+    // Hit covers the nearest 2x2 pixels (holes are left by magnification otherwise)
+    ivec2 base = ivec2(floor(coord - 0.5));
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            ivec2 p = base + ivec2(x, y);
+            if (p.x >= 0 && p.y >= 0 && p.x < frame_w && p.y < frame_h) {
+                imageAtomicMin(hint_image, p, hint);
+            }
+        }
+    }
+} // End of 'main' function
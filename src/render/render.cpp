@@ -109,8 +109,12 @@ void Render::startRenderLoop() {
         glfwSetWindowTitle(
             windowInstance,
             ("FPS: " + ::std::to_string(static_cast<int>(deltaTime == 0 ? 0 : 1 / deltaTime)) +
-             " | Render type: " + (scene.getRenderType() == RenderType::COMMON ? "common" : "rm") + " (press " +
-             (scene.getRenderType() == RenderType::COMMON ? "\"R\"" : "\"C\"") + " for change)")
+             " | Render type: " +
+             (scene.getRenderType() == RenderType::COMMON        ? "common"
+              : scene.getRenderType() == RenderType::RM          ? "rm"
+              : scene.getRenderType() == RenderType::RM_BYTECODE ? "rm bytecode"
+                                                                 : "rm compute") +
+             " (press \"C\"/\"R\"/\"B\"/\"T\" for change)")
                 .c_str()
         );
 
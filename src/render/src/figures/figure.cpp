@@ -56,22 +56,22 @@ FigureId & FigureId::operator%=(const FigureId &other) {
 }
 
 FigureId & FigureId::operator<<(const TransformationMatrixId &trId) {
-    Render::scene.getFigureById(*this).addTransformation(trId);
+    Render::scene.addTransformation(*this, trId);
     return *this;
 }
 
 FigureId & FigureId::operator<<(const math::matr4 &matr) {
-    TransformationId trId = Render::scene.createTransformation(matr);
-    Render::scene.getFigureById(*this).addTransformation(trId);
+    TransformationId trId = Render::scene.createStaticTransformation(matr);
+    Render::scene.addTransformation(*this, trId);
     return *this;
 }
 FigureId & FigureId::operator<<(const TransformationBendId &trId) {
-    Render::scene.getFigureById(*this).addTransformation(trId);
+    Render::scene.addTransformation(*this, trId);
     return *this;
 }
 
 FigureId & FigureId::operator<<(const TransformationTwistId &trId) {
-    Render::scene.getFigureById(*this).addTransformation(trId);
+    Render::scene.addTransformation(*this, trId);
     return *this;
 }
 
@@ -95,6 +95,10 @@ std::vector<FigureId> Figure::getSourceFigures() const {
     return std::get<std::vector<FigureId>>(m_sources);
 }
 
+int Figure::getRepeatId() const {
+    return m_repeatId;
+}
+
 void Figure::addTransformation(const TransformationId &tr) {
     m_transforms.push_back(tr);
 }
@@ -37,6 +37,21 @@ struct alignas(16) BoxPrimitive {
     float size;
 };
 
+// Domain repetition parameters (struct compatible with ssbo)
+struct alignas(16) RepeatParameters {
+    float period[4] = {};  // Distance between neighbour copies along each axis
+    float count[4] = {};   // Number of copies along each axis
+
+    RepeatParameters(const math::vec3 &period_, const math::vec3 &count_) {
+        period[0] = period_.x;
+        period[1] = period_.y;
+        period[2] = period_.z;
+        count[0] = count_.x;
+        count[1] = count_.y;
+        count[2] = count_.z;
+    }
+};
+
 class FigureId {
 public:
     FigureId(int id) : m_id(id) {
@@ -78,7 +93,7 @@ private:
     int m_id;
 };
 
-enum class CreationType { PRIMITIVE, INTERSECTION, UNION, SUBTRACTION, SUNION };
+enum class CreationType { PRIMITIVE, INTERSECTION, UNION, SUBTRACTION, SUNION, REPEAT };
 
 class Figure {
 public:
@@ -92,12 +107,19 @@ public:
         : m_creationType(creationType), m_sources(sources), m_transforms() {
     }
 
+    // Repetition of the source figure (repeatId - index of the repetition parameters)
+    Figure(const FigureId &source, int repeatId)
+        : m_creationType(CreationType::REPEAT), m_sources(std::vector<FigureId>{source}), m_transforms(), m_repeatId(repeatId) {
+    }
+
     CreationType creationType() const;
 
     PrimitiveId getSourcePrimitive() const;
 
     std::vector<FigureId> getSourceFigures() const;
 
+    int getRepeatId() const;
+
     const std::vector<TransformationId> & getTransformations() const;
 
     void addTransformation(const TransformationId &tr);
@@ -106,6 +128,7 @@ private:
     CreationType m_creationType;
     std::variant<PrimitiveId, std::vector<FigureId>> m_sources;
     std::vector<TransformationId> m_transforms;
+    int m_repeatId = -1;
 };
 
 }
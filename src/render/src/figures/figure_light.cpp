@@ -0,0 +1,21 @@
+#include <cstring>
+#include "../../render.hpp"
+#include "figure_light.hpp"
+
+namespace hse {
+
+int LightId::id() const {
+    return m_id;
+}
+
+// Frame is marked as changed only by new values (same ones may be set every frame)
+void LightId::set(const math::vec3 &pos, const math::vec3 &color, float range) const {
+    PointLight &cur = Render::scene.getLightById(*this);
+    PointLight light = {pos, color, range};
+    if (std::memcmp(&cur, &light, sizeof(PointLight)) != 0) {
+        cur = light;
+        Render::scene.markChanged();
+    }
+}
+
+} // namespace "hse"
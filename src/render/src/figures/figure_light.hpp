@@ -0,0 +1,50 @@
+#ifndef HSE_PROJECT_FIGURE_LIGHT_HPP
+#define HSE_PROJECT_FIGURE_LIGHT_HPP
+
+namespace hse {
+class FigureScene;
+
+class LightId {
+    friend FigureScene;
+private:
+    LightId(int id) : m_id(id) {
+    }
+
+public:
+    LightId() {
+    }
+
+    int id() const;
+
+    // Move the light or change its color and range (black light is turned off)
+    void set(const math::vec3 &pos, const math::vec3 &color, float range) const;
+
+private:
+    int m_id;
+};
+
+// Point light lighting surfaces up to 'range' from it (struct compatible with ssbo)
+struct alignas(16) PointLight {
+    float pos[4] = {};    // 'w' - radius of the light source surface (shadow rays end at it)
+    float color[4] = {};  // 'w' - range
+
+    PointLight(
+        const math::vec3 &pos_,
+        const math::vec3 &color_,
+        float range,
+        float radius = 0
+    ) {
+        pos[0] = pos_.x;
+        pos[1] = pos_.y;
+        pos[2] = pos_.z;
+        pos[3] = radius;
+
+        color[0] = color_.x;
+        color[1] = color_.y;
+        color[2] = color_.z;
+        color[3] = range;
+    }
+};
+} // namespace "hse"
+
+#endif  // HSE_PROJECT_FIGURE_LIGHT_HPP
@@ -1,6 +1,8 @@
 #include "../../render.hpp"
 #include "figure_render.hpp"
 #include "../resources/shaders/shader.hpp"
+#include <cstring>
+#include <utility>
 
 namespace hse {
 void CommonRender::init() {
@@ -63,6 +65,7 @@ void CommonRender::preparePrimitives(const FigureId &id, math::matr4 tranformati
         }
     }
     else {
+        // Repetition is shown as its single source figure
         const std::vector<FigureId> &sources = figure.getSourceFigures();
         for (auto &figId : sources) {
             preparePrimitives(figId, tranformation);
@@ -78,6 +81,8 @@ void RMRender::init() {
     m_matricesSSBO.setData(scene.getMatrices(), 4);
     m_twistsSSBO.setData(scene.getTwistings(), 5);
     m_bendsSSBO.setData(scene.getBendings(), 6);
+    m_repeatsSSBO.setData(scene.getRepeats(), 10);
+    m_revision = scene.getRevision();
 
     std::vector<int> indexBuffer(6);
     std::vector<float> vertexBuffer = {-1, -1, 0,
@@ -90,13 +95,38 @@ void RMRender::init() {
     for (int j = 0; j < 6; j++)
         indexBuffer[j] = j;
 
-    std::string vertexSource = createVertexSource("../data/shaders/rm/vertex.glsl", "../data/shaders/rm_render/vertex.glsl");
-    std::string fragmentSource = createFragmentSource("../data/shaders/rm/fragment_src.glsl", "../data/shaders/rm_render/fragment.glsl");
-    // TODO uint shdId = scene.createShader(vertexSource, fragmentSource, "rm_render");
-    shd = new Shader(vertexSource, fragmentSource);
-    m_canvas = scene.createPrimitive(shd->getShaderProgramId(), vertexBuffer, "v3", indexBuffer);
-    m_canvas->addConstantUniform((int)windowWidth, "frame_w");
-    m_canvas->addConstantUniform((int)windowHeight, "frame_h");
+    m_vertexSource = createVertexSource("../data/shaders/rm/vertex.glsl", "../data/shaders/rm_render/vertex.glsl");
+    m_canvas = scene.createPrimitive(0, vertexBuffer, "v3", indexBuffer);
+    // Canvas is traced into frame image, screen shows the image upscaled to the window
+    m_canvas->setVisibility(false);
+    m_blitShader = std::make_unique<Shader>(m_vertexSource, createVertexSource("../data/shaders/rm/blit.glsl", ""));
+    m_screen = scene.createPrimitive(m_blitShader->getShaderProgramId(), vertexBuffer, "v3", indexBuffer);
+    m_renderWidth = windowWidth;
+    m_renderHeight = windowHeight;
+    glGenVertexArrays(1, &m_proxyVertexArray);
+    if (m_isBytecode) {
+        m_programSSBO.setData(getSDFSceneProgram(), 7);
+    }
+    // Tracing compute program (and programs of all other passes) is compiled on first use
+    if (!m_isCompute) {
+        updateShaderProgram();
+    }
+    m_inverseMatricesSSBO.setData(getInverseMatrices(), 8);
+    m_boundsSSBO.setData(getBounds(), 9);
+    m_lipschitzSSBO.setData(getLipschitzBounds(), 11);
+    m_figureBoundsSSBO.setData(getDrawnFigureBounds(), 12);
+    m_motionBoundsSSBO.setData(getMotionBounds(getDrawnFigureBounds()), 13);
+    // Steps of the pixels are added when steps view is shown
+    m_stepsSSBO.setData(std::vector<uint>(stepsHistogramSize), 14);
+    glGenBuffers(1, &m_stepsReadBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_stepsReadBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, stepsHistogramSize * sizeof(uint), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_lightsSSBO.setData(getLights(), 15);
+    // Lights are binned by every frame (grid is placed by bounds of the drawn figures)
+    m_lightClustersSSBO.setData(std::vector<uint>(lightGridSize * lightGridSize * lightGridSize + 2), 16);
+    m_canvas->addConstantUniform((int)m_renderWidth, "frame_w");
+    m_canvas->addConstantUniform((int)m_renderHeight, "frame_h");
     m_canvas->addUniform(&time, "time");
     m_canvas->addConstantUniform(scene.mainCamera.getPosition(), "cam_pos");
     m_canvas->addConstantUniform(scene.mainCamera.getDirection(), "cam_dir");
@@ -108,88 +138,1668 @@ void RMRender::init() {
 
 void RMRender::render() {
     FigureScene &scene = Render::scene;
-    m_spheresSSBO.updateData(scene.getSpheres());
-    m_boxesSSBO.updateData(scene.getBoxes());
-    m_matricesSSBO.updateData(scene.getMatrices());
-    m_twistsSSBO.updateData(scene.getTwistings());
-    m_bendsSSBO.updateData(scene.getBendings());
-    m_canvas->setVisibility(true);
-    m_canvas->addUniform(&time, "time");
-    m_canvas->addConstantUniform(scene.mainCamera.getPosition(), "cam_pos");
-    m_canvas->addConstantUniform(scene.mainCamera.getDirection(), "cam_dir");
-    m_canvas->addConstantUniform(scene.mainCamera.getUp(), "cam_up");
-    m_canvas->addConstantUniform(scene.mainCamera.getRight(), "cam_right");
-    m_canvas->addConstantUniform((int)windowWidth, "frame_w");
-    m_canvas->addConstantUniform((int)windowHeight, "frame_h");
-    m_canvas->addConstantUniform((int)scene.isBulb(), "is_bulb");
-    m_canvas->addConstantUniform(scene.getBulbPos(), "bulb_pos");
-    m_canvas->addConstantUniform(scene.getBulbColor(), "bulb_color");
+    // Still frame is not traced again, its jittered samples are accumulated instead (steps view shows the plain frame),
+    // every frame is traced if refinement is disabled
+    if (!scene.isFeature(RMFeature::REFINEMENT) || !updateStillFrame()) {
+        m_refinementSample = 0;
+    } else if (m_refinementSample < refinementSamples) {
+        m_refinementSample = scene.isStepsView() ? refinementSamples : m_refinementSample + 1;
+    }
+    if (m_refinementSample == 0) {
+        m_spheresSSBO.updateData(scene.getSpheres());
+        m_boxesSSBO.updateData(scene.getBoxes());
+        m_matricesSSBO.updateData(scene.getMatrices());
+        m_twistsSSBO.updateData(scene.getTwistings());
+        m_bendsSSBO.updateData(scene.getBendings());
+        m_repeatsSSBO.updateData(scene.getRepeats());
+        // Bytecode program is recompiled only with other features (its topology is in the ssbo)
+        bool isFeaturesChanged = m_featureDefines != getFeatureDefines();
+        if (m_revision != scene.getRevision() || isFeaturesChanged || (m_isCompute && m_computeProgram == 0)) {
+            m_revision = scene.getRevision();
+            if (m_isBytecode) {
+                m_programSSBO.updateData(getSDFSceneProgram());
+            }
+            if (!m_isBytecode || isFeaturesChanged) {
+                updateShaderProgram();
+            }
+        }
+        m_inverseMatricesSSBO.updateData(getInverseMatrices());
+        m_boundsSSBO.updateData(getBounds());
+        m_lipschitzSSBO.updateData(getLipschitzBounds());
+        std::vector<RMBound> figureBounds = getDrawnFigureBounds();
+        m_sceneBounds = getSceneBounds(figureBounds);
+        m_figureBoundsSSBO.updateData(figureBounds);
+        if (scene.isFeature(RMFeature::REPROJECTION)) {
+            m_motionBoundsSSBO.updateData(getMotionBounds(figureBounds));
+        } else {
+            // Motion since the last reprojected frame is unknown
+            m_prevFigureBounds.clear();
+        }
+        if (scene.isFeature(RMFeature::POINT_LIGHTS)) {
+            std::vector<PointLight> lights = getLights();
+            m_lightsSSBO.updateData(lights);
+            m_lightClustersSSBO.updateData(getLightClusters(lights));
+        }
+        updateRenderScale();
+        m_canvas->addUniform(&time, "time");
+        m_canvas->addConstantUniform(scene.mainCamera.getPosition(), "cam_pos");
+        m_canvas->addConstantUniform(scene.mainCamera.getDirection(), "cam_dir");
+        m_canvas->addConstantUniform(scene.mainCamera.getUp(), "cam_up");
+        m_canvas->addConstantUniform(scene.mainCamera.getRight(), "cam_right");
+        m_canvas->addConstantUniform((int)m_renderWidth, "frame_w");
+        m_canvas->addConstantUniform((int)m_renderHeight, "frame_h");
+        m_canvas->addConstantUniform((int)scene.isBulb(), "is_bulb");
+        m_canvas->addConstantUniform(scene.mainCamera.getViewProjection().inverting(), "raster_inv_view_proj");
+        m_canvas->addConstantUniform(scene.getBulbPos(), "bulb_pos");
+        m_canvas->addConstantUniform(scene.getBulbColor(), "bulb_color");
+        m_canvas->addConstantUniform(m_prevCamPos, "prev_cam_pos");
+        m_canvas->addConstantUniform(m_prevCamDir, "prev_cam_dir");
+        m_canvas->addConstantUniform(m_prevCamUp, "prev_cam_up");
+        m_canvas->addConstantUniform(m_prevCamRight, "prev_cam_right");
+        m_canvas->addConstantUniform((int)m_isSimpleShading, "is_simple_shading");
+        m_canvas->addConstantUniform(scene.getMaxSteps(), "max_steps");
+        m_canvas->addConstantUniform(scene.getRelaxation(), "relaxation");
+        m_canvas->addConstantUniform(m_sceneBounds.min, "scene_min");
+        m_canvas->addConstantUniform(m_sceneBounds.max, "scene_max");
+    }
+    // Accumulated frame is only shown again
+    if (m_refinementSample < refinementSamples) {
+        traceFrame();
+    }
+    // Images are sampled by screen (texture unit 0, hit distances - unit 2)
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, m_historyImage);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_frameImage);
+    m_screen->setVisibility(true);
+    m_screen->addConstantUniform((int)windowWidth, "screen_w");
+    m_screen->addConstantUniform((int)windowHeight, "screen_h");
+    m_screen->addConstantUniform(scene.mainCamera.getPosition(), "cam_pos");
+    m_screen->addConstantUniform(scene.mainCamera.getDirection(), "cam_dir");
+    m_screen->addConstantUniform(scene.mainCamera.getUp(), "cam_up");
+    m_screen->addConstantUniform(scene.mainCamera.getRight(), "cam_right");
+    // Lost details are restored the more the lower resolution is
+    m_screen->addConstantUniform(m_renderScale < 1 ? sharpness * (1 - m_renderScale) : 0.f, "sharpness");
+    m_prevCamPos = scene.mainCamera.getPosition();
+    m_prevCamDir = scene.mainCamera.getDirection();
+    m_prevCamUp = scene.mainCamera.getUp();
+    m_prevCamRight = scene.mainCamera.getRight();
+}
+
+void RMRender::traceFrame() {
+    FigureScene &scene = Render::scene;
+    m_canvas->addConstantUniform(getJitter(2), "jitter_x");
+    m_canvas->addConstantUniform(getJitter(3), "jitter_y");
+    beginTimerFrame();
+    if (m_renderWidth != 0 && m_renderHeight != 0) {
+        // Lit color exceeds 1 before secondary effects are added
+        updateImage(m_frameImage, m_frameImageWidth, m_frameImageHeight, m_renderWidth, m_renderHeight, GL_RGBA16F);
+        if (scene.isFeature(RMFeature::DEFERRED)) {
+            updateImage(m_normalImage, m_normalImageWidth, m_normalImageHeight, m_renderWidth, m_renderHeight, GL_RGBA16F);
+            updateImage(m_materialImage, m_materialImageWidth, m_materialImageHeight, m_renderWidth, m_renderHeight, GL_RGBA8);
+        }
+        if (m_refinementSample == 1) {
+            // Mean of the samples starts from the plain frame
+            updateImage(m_accumImage, m_accumImageWidth, m_accumImageHeight, m_renderWidth, m_renderHeight, GL_RGBA16F);
+            glCopyImageSubData(
+                m_frameImage, GL_TEXTURE_2D, 0, 0, 0, 0, m_accumImage, GL_TEXTURE_2D, 0, 0, 0, 0,
+                static_cast<int>(m_renderWidth), static_cast<int>(m_renderHeight), 1
+            );
+        }
+        if (scene.isStepsView()) {
+            updateStepsBuffer();
+        }
+        if (scene.isFeature(RMFeature::RASTER_DEPTH)) {
+            copyRasterDepth();
+        }
+        updateHistory();
+        if (scene.isFeature(RMFeature::REPROJECTION)) {
+            markPass("reprojection");
+            dispatchReprojection();
+        }
+        if (scene.isFeature(RMFeature::PROXIES)) {
+            markPass("proxy raster");
+            drawProxies();
+        }
+        if (scene.isFeature(RMFeature::CONE_PREPASS)) {
+            markPass("cone prepass");
+            dispatchConePrepass();
+        }
+        // Surfaces are shaded by tracing pass itself unless shading is deferred
+        markPass(scene.isFeature(RMFeature::DEFERRED) ? "g-buffer" : "tracing");
+        if (m_isCompute) {
+            dispatchTiles();
+        } else {
+            drawCanvas();
+        }
+        if (scene.isFeature(RMFeature::DEFERRED)) {
+            markPass("lighting");
+            dispatchLighting();
+            // Governor leaves only direct light
+            if (!m_isSimpleShading) {
+                dispatchSecondaryEffects();
+            }
+        }
+        if (m_refinementSample > 0) {
+            markPass("accumulation");
+            dispatchAccumulation();
+        }
+        if (scene.isStepsView()) {
+            markPass("steps view");
+            dispatchStepsView();
+            copyStepsHistogram();
+        }
+        markPass("");
+    }
+    m_isHistoryJittered = m_refinementSample > 0;
+}
+
+bool RMRender::updateStillFrame() {
+    FigureScene &scene = Render::scene;
+    // Meshes are not tracked, units moving them mark the scene as changed
+    bool isStill = m_frameImage != 0 && m_frameStateRevision == scene.getStateRevision() &&
+                   m_frameCameraRevision == scene.mainCamera.getRevision() && m_frameWindowWidth == windowWidth &&
+                   m_frameWindowHeight == windowHeight;
+    m_frameStateRevision = scene.getStateRevision();
+    m_frameCameraRevision = scene.mainCamera.getRevision();
+    m_frameWindowWidth = windowWidth;
+    m_frameWindowHeight = windowHeight;
+    return isStill;
+}
+
+float RMRender::getJitter(int base) const {
+    // Radical inverse of the sample index (low discrepancy points inside of the pixel)
+    float jitter = 0, digit = 1;
+    for (int i = m_refinementSample; i > 0; i /= base) {
+        digit /= static_cast<float>(base);
+        jitter += digit * static_cast<float>(i % base);
+    }
+    return m_refinementSample == 0 ? 0 : jitter - 0.5f;
+}
+
+int RMRender::getSecondaryScale() const {
+    return m_refinementSample > 0 ? 1 : Render::scene.getSecondaryScale();
+}
+
+void RMRender::dispatchAccumulation() {
+    if (m_accumulateShader == nullptr) {
+        m_accumulateShader = std::make_unique<Shader>(GL_COMPUTE_SHADER, createVertexSource("../data/shaders/rm/accumulate.glsl", ""));
+    }
+    glBindImageTexture(0, m_frameImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glBindImageTexture(1, m_accumImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    uint program = m_accumulateShader->getShaderProgramId();
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "frame_w"), static_cast<int>(m_renderWidth));
+    glUniform1i(glGetUniformLocation(program, "frame_h"), static_cast<int>(m_renderHeight));
+    glUniform1f(glGetUniformLocation(program, "weight"), 1.f / static_cast<float>(m_refinementSample + 1));
+    glDispatchCompute(
+        (m_renderWidth + accumulateGroupSize - 1) / accumulateGroupSize, (m_renderHeight + accumulateGroupSize - 1) / accumulateGroupSize, 1
+    );
+    // Frame image is sampled by screen
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+RMRender::~RMRender() {
+    if (m_frameImage != 0) {
+        glDeleteTextures(1, &m_frameImage);
+    }
+    if (m_startImage != 0) {
+        glDeleteTextures(1, &m_startImage);
+    }
+    if (m_historyImage != 0) {
+        glDeleteTextures(1, &m_historyImage);
+    }
+    if (m_prevHistoryImage != 0) {
+        glDeleteTextures(1, &m_prevHistoryImage);
+    }
+    if (m_hintImage != 0) {
+        glDeleteTextures(1, &m_hintImage);
+    }
+    if (m_normalImage != 0) {
+        glDeleteTextures(1, &m_normalImage);
+    }
+    if (m_materialImage != 0) {
+        glDeleteTextures(1, &m_materialImage);
+    }
+    if (m_effectsImage != 0) {
+        glDeleteTextures(1, &m_effectsImage);
+    }
+    if (m_bulbLightImage != 0) {
+        glDeleteTextures(1, &m_bulbLightImage);
+    }
+    if (m_frameBuffer != 0) {
+        glDeleteFramebuffers(1, &m_frameBuffer);
+    }
+    if (m_proxyImage != 0) {
+        glDeleteTextures(1, &m_proxyImage);
+    }
+    if (m_proxyFrameBuffer != 0) {
+        glDeleteFramebuffers(1, &m_proxyFrameBuffer);
+    }
+    if (m_proxyVertexArray != 0) {
+        glDeleteVertexArrays(1, &m_proxyVertexArray);
+    }
+    if (m_rasterDepthImage != 0) {
+        glDeleteTextures(1, &m_rasterDepthImage);
+    }
+    if (m_accumImage != 0) {
+        glDeleteTextures(1, &m_accumImage);
+    }
+    for (RMFrameTimer &timer : m_timers) {
+        glDeleteQueries(static_cast<int>(timer.queries.size()), timer.queries.data());
+    }
+    if (m_stepsReadBuffer != 0) {
+        glDeleteBuffers(1, &m_stepsReadBuffer);
+    }
+    if (m_stepsFence != nullptr) {
+        glDeleteSync(m_stepsFence);
+    }
+}
+
+void RMRender::updateRenderScale() {
+    float targetFrameTime = Render::scene.getTargetFrameTime();
+    if (targetFrameTime <= 0) {
+        m_renderScale = 1;
+        m_isSimpleShading = false;
+        m_frameTime = 0;
+    } else if (deltaTime > 0) {
+        m_frameTime = m_frameTime == 0 ? deltaTime : m_frameTime * (1 - frameTimeSmoothing) + deltaTime * frameTimeSmoothing;
+        if (m_scaleCooldown > 0) {
+            m_scaleCooldown--;
+        } else if (m_frameTime > targetFrameTime * 1.1f) {
+            // Secondary effects are dropped only if the lowest resolution is not enough
+            if (m_renderScale > minRenderScale) {
+                m_renderScale = std::max(minRenderScale, m_renderScale - renderScaleStep);
+            } else {
+                m_isSimpleShading = true;
+            }
+            m_scaleCooldown = scaleCooldownFrames;
+        } else if (m_frameTime < targetFrameTime * 0.8f && (m_isSimpleShading || m_renderScale < 1)) {
+            if (m_isSimpleShading) {
+                m_isSimpleShading = false;
+            } else {
+                m_renderScale = std::min(1.f, m_renderScale + renderScaleStep);
+            }
+            m_scaleCooldown = scaleCooldownFrames;
+        }
+    }
+    m_renderWidth = std::max(1u, static_cast<uint>(std::lround(windowWidth * m_renderScale)));
+    m_renderHeight = std::max(1u, static_cast<uint>(std::lround(windowHeight * m_renderScale)));
+    if (windowWidth == 0 || windowHeight == 0) {
+        m_renderWidth = m_renderHeight = 0;
+    }
+}
+
+void RMRender::drawCanvas() {
+    if (m_frameBuffer == 0) {
+        glGenFramebuffers(1, &m_frameBuffer);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+    // G-buffer attachments (history image is swapped every frame), must match canvas outputs,
+    // shaded colors replace materials and normals are not written if shading is not deferred
+    bool isDeferred = Render::scene.isFeature(RMFeature::DEFERRED);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, isDeferred ? m_materialImage : m_frameImage, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, isDeferred ? m_normalImage : 0, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, m_historyImage, 0);
+    GLenum normalBuffer = isDeferred ? GL_COLOR_ATTACHMENT1 : GL_NONE;
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, normalBuffer, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, drawBuffers);
+    glViewport(0, 0, static_cast<int>(m_renderWidth), static_cast<int>(m_renderHeight));
+    m_canvas->onRender(Render::scene.mainCamera);
+    // Steps of the pixels are completed by deferred passes
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight));
+}
+
+void RMRender::updateImage(uint &image, uint &imageWidth, uint &imageHeight, uint width, uint height, uint format) {
+    if (image != 0 && imageWidth == width && imageHeight == height) {
+        return;
+    }
+    if (image != 0) {
+        glDeleteTextures(1, &image);
+    }
+    imageWidth = width;
+    imageHeight = height;
+    glGenTextures(1, &image);
+    glBindTexture(GL_TEXTURE_2D, image);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, static_cast<int>(width), static_cast<int>(height));
+    // Frame image is upscaled by sampling
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RMRender::updateHistory() {
+    // Distances written by the last frame become the previous ones
+    std::swap(m_historyImage, m_prevHistoryImage);
+    std::swap(m_historyImageWidth, m_prevHistoryImageWidth);
+    std::swap(m_historyImageHeight, m_prevHistoryImageHeight);
+    // Distances of the previous frame are lost if render resolution is changed
+    m_isHistory = m_prevHistoryImage != 0 && m_prevHistoryImageWidth == m_renderWidth && m_prevHistoryImageHeight == m_renderHeight;
+    updateImage(m_historyImage, m_historyImageWidth, m_historyImageHeight, m_renderWidth, m_renderHeight, GL_R32F);
+    // Current distances are written by tracing pass (and sampled by screen as depth)
+    glBindImageTexture(2, m_historyImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+}
+
+void RMRender::dispatchReprojection() {
+    updateImage(m_prevHistoryImage, m_prevHistoryImageWidth, m_prevHistoryImageHeight, m_renderWidth, m_renderHeight, GL_R32F);
+    updateImage(m_hintImage, m_hintImageWidth, m_hintImageHeight, m_renderWidth, m_renderHeight, GL_R32UI);
+    // Previous distances are read here and by tracing pass (to validate hints)
+    glBindImageTexture(4, m_prevHistoryImage, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(3, m_hintImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+    // Bits of max float (no hint), positive floats keep their order as unsigned ints
+    uint noHint = 0x7F7FFFFF;
+    glClearTexImage(m_hintImage, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &noHint);
+
+    // Hits of the jittered rays are not at pixel centers, so hints are not reprojected to or from them
+    if (m_isHistory && !m_isSceneChanged && !m_isHistoryJittered && m_refinementSample == 0) {
+        if (m_reprojectShader == nullptr) {
+            m_reprojectShader = std::make_unique<Shader>(GL_COMPUTE_SHADER, createVertexSource("../data/shaders/rm/reproject.glsl", ""));
+        }
+        uint program = m_reprojectShader->getShaderProgramId();
+        FigureScene &scene = Render::scene;
+        auto setVector = [program](const char *name, const math::vec3 &value) {
+            glUniform3fv(glGetUniformLocation(program, name), 1, &value.x);
+        };
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "frame_w"), static_cast<int>(m_renderWidth));
+        glUniform1i(glGetUniformLocation(program, "frame_h"), static_cast<int>(m_renderHeight));
+        setVector("cam_pos", scene.mainCamera.getPosition());
+        setVector("cam_dir", scene.mainCamera.getDirection());
+        setVector("cam_up", scene.mainCamera.getUp());
+        setVector("cam_right", scene.mainCamera.getRight());
+        setVector("prev_cam_pos", m_prevCamPos);
+        setVector("prev_cam_dir", m_prevCamDir);
+        setVector("prev_cam_up", m_prevCamUp);
+        setVector("prev_cam_right", m_prevCamRight);
+        glDispatchCompute((m_renderWidth + reprojectGroupSize - 1) / reprojectGroupSize, (m_renderHeight + reprojectGroupSize - 1) / reprojectGroupSize, 1);
+        glUseProgram(0);
+    }
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void RMRender::copyRasterDepth() {
+    updateImage(m_rasterDepthImage, m_rasterDepthImageWidth, m_rasterDepthImageHeight, windowWidth, windowHeight, GL_DEPTH_COMPONENT32F);
+    // Meshes are drawn before ray marching (see 'FigureScene::onRender'), window framebuffer is read
+    glBindTexture(GL_TEXTURE_2D, m_rasterDepthImage);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight));
+    // Sampled by tracing (texture unit 1)
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_rasterDepthImage);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RMRender::drawProxies() {
+    if (m_proxyFrameBuffer == 0) {
+        glGenFramebuffers(1, &m_proxyFrameBuffer);
+    }
+    updateImage(m_proxyImage, m_proxyImageWidth, m_proxyImageHeight, m_renderWidth, m_renderHeight, GL_RG32F);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_proxyFrameBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_proxyImage, 0);
+    // Pixels not covered by any box see background only
+    const float noCover[4] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), 0, 0};
+    glClearBufferfv(GL_COLOR, 0, noCover);
+    glViewport(0, 0, static_cast<int>(m_renderWidth), static_cast<int>(m_renderHeight));
+
+    if (m_proxyShader == nullptr) {
+        m_proxyShader = std::make_unique<Shader>(
+            createVertexSource("../data/shaders/rm/proxy_vertex.glsl", ""), createVertexSource("../data/shaders/rm/proxy.glsl", "")
+        );
+    }
+    uint program = m_proxyShader->getShaderProgramId();
+    FigureScene &scene = Render::scene;
+    auto setVector = [program](const char *name, const math::vec3 &value) {
+        glUniform3fv(glGetUniformLocation(program, name), 1, &value.x);
+    };
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "frame_w"), static_cast<int>(m_renderWidth));
+    glUniform1i(glGetUniformLocation(program, "frame_h"), static_cast<int>(m_renderHeight));
+    glUniform1f(glGetUniformLocation(program, "jitter_x"), getJitter(2));
+    glUniform1f(glGetUniformLocation(program, "jitter_y"), getJitter(3));
+    setVector("cam_pos", scene.mainCamera.getPosition());
+    setVector("cam_dir", scene.mainCamera.getDirection());
+    setVector("cam_up", scene.mainCamera.getUp());
+    setVector("cam_right", scene.mainCamera.getRight());
+    // Interval of every pixel is the union of intervals of its boxes (both sides of a box give the same one)
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_MIN);
+    glBindVertexArray(m_proxyVertexArray);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, static_cast<int>(scene.getScene().size()));
+    glBindVertexArray(0);
+    glBlendEquation(GL_FUNC_ADD);
+    glDisable(GL_BLEND);
+    glUseProgram(0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, static_cast<int>(windowWidth), static_cast<int>(windowHeight));
+    // Read by cone prepass and tracing (the unit is taken by bulb light in deferred passes)
+    glBindImageTexture(7, m_proxyImage, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+}
+
+void RMRender::setComputeUniforms(uint program) const {
+    FigureScene &scene = Render::scene;
+    auto setVector = [program](const char *name, const math::vec3 &value) {
+        glUniform3fv(glGetUniformLocation(program, name), 1, &value.x);
+    };
+    glUniform1f(glGetUniformLocation(program, "time"), time);
+    glUniform1i(glGetUniformLocation(program, "frame_w"), static_cast<int>(m_renderWidth));
+    glUniform1i(glGetUniformLocation(program, "frame_h"), static_cast<int>(m_renderHeight));
+    glUniform1i(glGetUniformLocation(program, "is_bulb"), static_cast<int>(scene.isBulb()));
+    setVector("cam_pos", scene.mainCamera.getPosition());
+    setVector("cam_dir", scene.mainCamera.getDirection());
+    setVector("cam_up", scene.mainCamera.getUp());
+    setVector("cam_right", scene.mainCamera.getRight());
+    setVector("bulb_pos", scene.getBulbPos());
+    setVector("bulb_color", scene.getBulbColor());
+    setVector("prev_cam_pos", m_prevCamPos);
+    setVector("prev_cam_dir", m_prevCamDir);
+    setVector("prev_cam_up", m_prevCamUp);
+    setVector("prev_cam_right", m_prevCamRight);
+    glUniform1i(glGetUniformLocation(program, "is_simple_shading"), static_cast<int>(m_isSimpleShading));
+    glUniform1i(glGetUniformLocation(program, "secondary_scale"), getSecondaryScale());
+    glUniform1f(glGetUniformLocation(program, "jitter_x"), getJitter(2));
+    glUniform1f(glGetUniformLocation(program, "jitter_y"), getJitter(3));
+    glUniform1i(glGetUniformLocation(program, "max_steps"), scene.getMaxSteps());
+    glUniform1f(glGetUniformLocation(program, "relaxation"), scene.getRelaxation());
+    setVector("scene_min", m_sceneBounds.min);
+    setVector("scene_max", m_sceneBounds.max);
+    math::matr4 rasterInvViewProj = scene.mainCamera.getViewProjection().inverting();
+    glUniformMatrix4fv(glGetUniformLocation(program, "raster_inv_view_proj"), 1, GL_FALSE, &rasterInvViewProj.matrix[0][0]);
+}
+
+void RMRender::dispatchConePrepass() {
+    if (m_renderWidth == 0 || m_renderHeight == 0) {
+        return;
+    }
+    if (m_prepassProgram == 0) {
+        m_prepassProgram = getPassProgram(ShaderPass::CONE_PREPASS);
+    }
+    uint blocksX = (m_renderWidth + coneBlockSize - 1) / coneBlockSize;
+    uint blocksY = (m_renderHeight + coneBlockSize - 1) / coneBlockSize;
+    updateImage(m_startImage, m_startImageWidth, m_startImageHeight, blocksX, blocksY, GL_R32F);
+    // Written by prepass and read by tracing pass (fragment or compute one)
+    glBindImageTexture(1, m_startImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+
+    glUseProgram(m_prepassProgram);
+    setComputeUniforms(m_prepassProgram);
+    glDispatchCompute((blocksX + coneGroupSize - 1) / coneGroupSize, (blocksY + coneGroupSize - 1) / coneGroupSize, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+void RMRender::dispatchTiles() {
+    if (m_renderWidth == 0 || m_renderHeight == 0) {
+        return;
+    }
+    if (Render::scene.isFeature(RMFeature::DEFERRED)) {
+        glBindImageTexture(5, m_normalImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+        glBindImageTexture(6, m_materialImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
+    } else {
+        glBindImageTexture(0, m_frameImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    }
+
+    glUseProgram(m_computeProgram);
+    setComputeUniforms(m_computeProgram);
+    glDispatchCompute(
+        (m_renderWidth + computeTileSize - 1) / computeTileSize, (m_renderHeight + computeTileSize - 1) / computeTileSize, 1
+    );
+    // Steps of the pixels are completed by deferred passes, shaded frame image is sampled by screen
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+void RMRender::dispatchLighting() {
+    if (m_lightingProgram == 0) {
+        m_lightingProgram = getPassProgram(ShaderPass::LIGHTING);
+    }
+    // Hit distances are bound by history update
+    glBindImageTexture(0, m_frameImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glBindImageTexture(5, m_normalImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glBindImageTexture(6, m_materialImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA8);
+
+    glUseProgram(m_lightingProgram);
+    setComputeUniforms(m_lightingProgram);
+    glDispatchCompute(
+        (m_renderWidth + deferredGroupSize - 1) / deferredGroupSize, (m_renderHeight + deferredGroupSize - 1) / deferredGroupSize, 1
+    );
+    // Frame image is sampled by screen or completed by secondary effects (and steps view)
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+void RMRender::dispatchSecondaryEffects() {
+    if (m_secondaryProgram == 0) {
+        m_secondaryProgram = getPassProgram(ShaderPass::SECONDARY);
+        m_compositeProgram = getPassProgram(ShaderPass::COMPOSITE);
+    }
+    uint scale = static_cast<uint>(getSecondaryScale());
+    uint width = (m_renderWidth + scale - 1) / scale, height = (m_renderHeight + scale - 1) / scale;
+    updateImage(m_effectsImage, m_effectsImageWidth, m_effectsImageHeight, width, height, GL_RGBA16F);
+    updateImage(m_bulbLightImage, m_bulbLightImageWidth, m_bulbLightImageHeight, width, height, GL_R16F);
+    // Frame image is completed in place, G-buffer is bound by lighting (materials are replaced by effects)
+    glBindImageTexture(6, m_effectsImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glBindImageTexture(7, m_bulbLightImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R16F);
+
+    markPass("secondary");
+    glUseProgram(m_secondaryProgram);
+    setComputeUniforms(m_secondaryProgram);
+    glDispatchCompute((width + deferredGroupSize - 1) / deferredGroupSize, (height + deferredGroupSize - 1) / deferredGroupSize, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    markPass("composite");
+    // Surfaces lit by point lights need their colors (unit of the hints is free after tracing)
+    glBindImageTexture(3, m_materialImage, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+    glUseProgram(m_compositeProgram);
+    setComputeUniforms(m_compositeProgram);
+    glDispatchCompute(
+        (m_renderWidth + deferredGroupSize - 1) / deferredGroupSize, (m_renderHeight + deferredGroupSize - 1) / deferredGroupSize, 1
+    );
+    // Frame image is sampled by screen (or replaced by steps view)
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+void RMRender::updateStepsBuffer() {
+    // Copy is read only if GPU has finished it (reading unfinished one would wait for the whole frame)
+    GLenum status = m_stepsFence == nullptr ? GL_TIMEOUT_EXPIRED : glClientWaitSync(m_stepsFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+        glDeleteSync(m_stepsFence);
+        m_stepsFence = nullptr;
+        std::vector<uint> histogram(stepsHistogramSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_stepsReadBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, stepsHistogramSize * sizeof(uint), histogram.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        GLuint64 pixels = 0, steps = 0;
+        for (int i = 0; i < stepsHistogramSize; i++) {
+            pixels += histogram[i];
+            steps += static_cast<GLuint64>(histogram[i]) * i;
+        }
+        // The least steps count not exceeded by 99% of the pixels
+        int percentile99 = 0;
+        GLuint64 count = histogram[0];
+        while (count * 100 < pixels * 99 && percentile99 < stepsHistogramSize - 1) {
+            count += histogram[++percentile99];
+        }
+        if (pixels > 0) {
+            m_stepStats = {static_cast<float>(steps) / static_cast<float>(pixels), percentile99};
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_stepsSSBO.getBufferId());
+    uint pixels = m_renderWidth * m_renderHeight;
+    if (m_stepsBufferPixels != pixels) {
+        m_stepsBufferPixels = pixels;
+        m_stepsSSBO.updateData(std::vector<uint>(stepsHistogramSize + pixels));
+    } else {
+        // Steps of the pixels are rewritten by tracing
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, stepsHistogramSize * sizeof(uint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, m_stepsSSBO.getBufferId());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void RMRender::dispatchStepsView() {
+    if (m_stepsProgram == 0) {
+        m_stepsProgram = getPassProgram(ShaderPass::STEPS);
+    }
+    // Frame image is replaced by the heatmap
+    glBindImageTexture(0, m_frameImage, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+    glUseProgram(m_stepsProgram);
+    setComputeUniforms(m_stepsProgram);
+    glDispatchCompute(
+        (m_renderWidth + deferredGroupSize - 1) / deferredGroupSize, (m_renderHeight + deferredGroupSize - 1) / deferredGroupSize, 1
+    );
+    // Frame image is sampled by screen, histogram is copied to be read back
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+void RMRender::copyStepsHistogram() {
+    // Unread copy is kept, so statistics are of the frames GPU keeps up with
+    if (m_stepsFence != nullptr) {
+        return;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, m_stepsSSBO.getBufferId());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_stepsReadBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, stepsHistogramSize * sizeof(uint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_stepsFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RMRender::beginTimerFrame() {
+    m_timerFrame = (m_timerFrame + 1) % timerFrames;
+    RMFrameTimer &timer = m_timers[m_timerFrame];
+    // Frame measured 'timerFrames' ago is read only if GPU has finished it (dropped otherwise)
+    if (!timer.passes.empty()) {
+        int isAvailable = 0;
+        glGetQueryObjectiv(timer.queries[timer.passes.size()], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (isAvailable) {
+            m_passTimes.clear();
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(timer.queries[0], GL_QUERY_RESULT, &start);
+            for (size_t i = 0; i < timer.passes.size(); i++) {
+                glGetQueryObjectui64v(timer.queries[i + 1], GL_QUERY_RESULT, &end);
+                m_passTimes.emplace_back(timer.passes[i], static_cast<float>(end - start) / 1e6f);
+                start = end;
+            }
+        }
+    }
+    timer.passes.clear();
+}
+
+void RMRender::markPass(const std::string &name) {
+    RMFrameTimer &timer = m_timers[m_timerFrame];
+    if (timer.queries.size() <= timer.passes.size()) {
+        uint query;
+        glGenQueries(1, &query);
+        timer.queries.push_back(query);
+    }
+    glQueryCounter(timer.queries[timer.passes.size()], GL_TIMESTAMP);
+    if (!name.empty()) {
+        timer.passes.push_back(name);
+    }
+}
+
+std::vector<std::pair<std::string, float>> RMRender::getPassTimes() const {
+    return m_passTimes;
+}
+
+StepStats RMRender::getStepStats() const {
+    return m_stepStats;
 }
 
 void RMRender::hide() {
-    m_canvas->setVisibility(false);
+    m_screen->setVisibility(false);
+}
+
+void RMRender::updateShaderProgram() {
+    m_featureDefines = getFeatureDefines();
+    // Scene functions are the same in every pass, so they are generated once
+    std::string sceneSource = m_isBytecode ? "" : getSDFSceneSource();
+    std::string fragmentSource =
+        createFragmentSource("../data/shaders/rm/fragment_src.glsl", "../data/shaders/rm_render/fragment.glsl", sceneSource);
+    auto it = m_shaders.find(fragmentSource);
+    if (it == m_shaders.end()) {
+        auto shader = m_isCompute ? std::make_unique<Shader>(GL_COMPUTE_SHADER, fragmentSource)
+                                  : std::make_unique<Shader>(m_vertexSource, fragmentSource);
+        it = m_shaders.emplace(std::move(fragmentSource), std::move(shader)).first;
+    }
+    if (m_isCompute) {
+        m_computeProgram = it->second->getShaderProgramId();
+    } else {
+        m_canvas->setShaderProgram(it->second->getShaderProgramId());
+    }
+
+    // Programs of other passes are compiled from the same scene functions when their pass runs
+    m_passSceneSource = std::move(sceneSource);
+    m_prepassProgram = 0;
+    m_lightingProgram = 0;
+    m_secondaryProgram = 0;
+    m_compositeProgram = 0;
+    m_stepsProgram = 0;
+}
+
+uint RMRender::getPassProgram(ShaderPass pass) {
+    std::string source = createFragmentSource("../data/shaders/rm/fragment_src.glsl", "", m_passSceneSource, pass);
+    auto it = m_shaders.find(source);
+    if (it == m_shaders.end()) {
+        auto shader = std::make_unique<Shader>(GL_COMPUTE_SHADER, source);
+        it = m_shaders.emplace(std::move(source), std::move(shader)).first;
+    }
+    return it->second->getShaderProgramId();
+}
+
+std::vector<int> RMRender::getMatrixChain(const Figure &figure, int &index) const {
+    const std::vector<TransformationId> &transforms = figure.getTransformations();
+    int last = index;
+    while (index > 0 && transforms[index - 1].type() == TransformationType::MATRIX) {
+        index--;
+    }
+    std::vector<int> chain;
+    for (int i = index; i <= last; i++) {
+        chain.push_back(transforms[i].id());
+    }
+    return chain;
+}
+
+std::vector<int> RMRender::getInnerMatrixChain(const Figure &figure, int index) const {
+    const std::vector<TransformationId> &transforms = figure.getTransformations();
+    std::vector<int> chain;
+    for (int i = 0; i < index; i++) {
+        if (transforms[i].type() == TransformationType::MATRIX) {
+            chain.push_back(transforms[i].id());
+        }
+    }
+    return chain;
+}
+
+int RMRender::getMatrixChainSlot(const std::vector<int> &chain, bool isInverse) {
+    std::pair<std::vector<int>, bool> key(chain, isInverse);
+    auto it = m_matrixChainSlots.find(key);
+    if (it != m_matrixChainSlots.end()) {
+        return it->second;
+    }
+    int slot = static_cast<int>(m_matrixChains.size());
+    m_matrixChainSlots.emplace(key, slot);
+    m_matrixChains.push_back(std::move(key));
+    return slot;
+}
+
+math::matr4 RMRender::getMatrixChainProduct(const std::vector<int> &chain) {
+    const std::vector<math::matr4> &matrices = Render::scene.getMatrices();
+    math::matr4 m = matrices[chain.front()];
+    for (auto it = chain.begin() + 1; it != chain.end(); it++) {
+        m = m * matrices[*it];
+    }
+    return m;
+}
+
+math::matr4 RMRender::getMatrixChainInverse(const std::vector<int> &chain) {
+    return getMatrixChainProduct(chain).inverting();
+}
+
+std::vector<math::matr4> RMRender::getInverseMatrices() const {
+    std::vector<math::matr4> res;
+    res.reserve(m_matrixChains.size());
+    for (const auto &[chain, isInverse] : m_matrixChains) {
+        res.push_back(isInverse ? getMatrixChainInverse(chain) : getMatrixChainProduct(chain));
+    }
+    // Empty ssbo is not allowed
+    if (res.empty()) {
+        res.emplace_back();
+    }
+    return res;
 }
 
-std::string RMRender::serializeOperation(const std::string &operationName, const std::vector<FigureId> &sources, const std::string &pos, const std::string &matr) {
-    std::string res = serializeFigureId(sources.front(), pos, matr);
+/* Get bounding box of transformed box function.
+ * ARGUMENTS:
+ *   - box to transform:
+ *       const RMBoundingBox &box;
+ *   - transformation matrix:
+ *       const math::matr4 &matr;
+ * RETURNS:
+ *   (RMBoundingBox) - box containing all transformed corners.
+ */
+static RMBoundingBox transformBoundingBox(const RMBoundingBox &box, const math::matr4 &matr) {
+    RMBoundingBox res{math::vec3(INFINITY), math::vec3(-INFINITY), box.maxScale};
+    for (int i = 0; i < 8; i++) {
+        math::vec3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+        corner = matr.transformPoint(corner);
+        res.min = math::vec3::min(res.min, corner);
+        res.max = math::vec3::max(res.max, corner);
+    }
+    return res;
+}  // End of 'transformBoundingBox' function
+
+/* Get bounding box of box rotated by any angle around any axis through the frame origin function.
+ * ARGUMENTS:
+ *   - box to rotate:
+ *       const RMBoundingBox &box.
+ * RETURNS:
+ *   (RMBoundingBox) - bounding box of the sphere containing all rotated corners.
+ * NOTE: Twisting and bending rotate every point around the axis through the frame origin
+ * (their center sets the angle only), so distance to the origin is preserved.
+ */
+static RMBoundingBox rotateBoundingBox(const RMBoundingBox &box) {
+    float radius = !math::vec3::max(box.max, -box.min);
+    return {math::vec3(-radius), math::vec3(radius), box.maxScale};
+}  // End of 'rotateBoundingBox' function
+
+/* Check if two ssbo structures have the same fields functions.
+ * ARGUMENTS:
+ *   - structures to compare:
+ *       const T &a, &b.
+ * RETURNS:
+ *   (bool) - true if all fields are the same.
+ * NOTE: Padding of the structures is not compared (it may be left uninitialized).
+ */
+static bool isSameElement(const TransformationTwist &a, const TransformationTwist &b) {
+    return std::memcmp(a.pos, b.pos, sizeof(a.pos)) == 0 && std::memcmp(a.dir, b.dir, sizeof(a.dir)) == 0 &&
+           a.intensity == b.intensity;
+}  // End of 'isSameElement' function
+
+static bool isSameElement(const TransformationBend &a, const TransformationBend &b) {
+    return std::memcmp(a.pos, b.pos, sizeof(a.pos)) == 0 && std::memcmp(a.dir, b.dir, sizeof(a.dir)) == 0 &&
+           std::memcmp(a.rad, b.rad, sizeof(a.rad)) == 0;
+}  // End of 'isSameElement' function
+
+static bool isSameElement(const RepeatParameters &a, const RepeatParameters &b) {
+    return std::memcmp(a.period, b.period, sizeof(a.period)) == 0 && std::memcmp(a.count, b.count, sizeof(a.count)) == 0;
+}  // End of 'isSameElement' function
+
+/* Check if two arrays of ssbo structures have the same data function.
+ * ARGUMENTS:
+ *   - arrays to compare:
+ *       const std::vector<T> &a, &b.
+ * RETURNS:
+ *   (bool) - true if data is the same.
+ */
+template<typename T>
+static bool isSameData(const std::vector<T> &a, const std::vector<T> &b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](const T &x, const T &y) { return isSameElement(x, y); });
+}  // End of 'isSameData' function
+
+/* Convert bounding box to ssbo bound function.
+ * ARGUMENTS:
+ *   - box to convert:
+ *       const RMBoundingBox &box.
+ * RETURNS:
+ *   (RMBound) - bound with box center and half size.
+ */
+static RMBound makeBound(const RMBoundingBox &box) {
+    math::vec3 cen = (box.min + box.max) / 2, halfSize = (box.max - box.min) / 2;
+    RMBound bound;
+    bound.cen[0] = cen.x;
+    bound.cen[1] = cen.y;
+    bound.cen[2] = cen.z;
+    bound.halfSize[0] = halfSize.x;
+    bound.halfSize[1] = halfSize.y;
+    bound.halfSize[2] = halfSize.z;
+    bound.maxScale = box.maxScale;
+    return bound;
+}  // End of 'makeBound' function
+
+/* Check if figure is deformed (its distance is not 1-Lipschitz even without scaling) function.
+ * ARGUMENTS:
+ *   - figure to check:
+ *       const Figure &figure.
+ * RETURNS:
+ *   (bool) - true if figure is twisted or bent.
+ */
+static bool isDeformed(const Figure &figure) {
+    const std::vector<TransformationId> &transforms = figure.getTransformations();
+    return std::any_of(transforms.begin(), transforms.end(), [](const TransformationId &trId) {
+        return trId.type() == TransformationType::TWIST || trId.type() == TransformationType::BEND;
+    });
+}  // End of 'isDeformed' function
+
+/* Check if figure or its sources use changed matrices function.
+ * ARGUMENTS:
+ *   - figure to check:
+ *       const Figure &figure;
+ *   - flags of changed matrices (by matrix id):
+ *       const std::vector<bool> &isMatrixChanged.
+ * RETURNS:
+ *   (bool) - true if figure is moved.
+ */
+static bool isMoved(const Figure &figure, const std::vector<bool> &isMatrixChanged) {
+    for (const TransformationId &trId : figure.getTransformations()) {
+        if (trId.type() == TransformationType::MATRIX && isMatrixChanged[trId.id()]) {
+            return true;
+        }
+    }
+    if (figure.creationType() == CreationType::PRIMITIVE) {
+        return false;
+    }
+    for (const FigureId &source : figure.getSourceFigures()) {
+        if (isMoved(Render::scene.getFigureById(source), isMatrixChanged)) {
+            return true;
+        }
+    }
+    return false;
+}  // End of 'isMoved' function
+
+void RMRender::getContextFrames(std::vector<math::matr4> &matrices, std::vector<float> &scales) const {
+    matrices.assign(m_contexts.size(), math::matr4());
+    scales.assign(m_contexts.size(), 1);
+    for (size_t i = 1; i < m_contexts.size(); i++) {
+        const Figure &figure = Render::scene.getFigureById(m_contexts[i].second);
+        math::matr4 matr = matrices[m_contexts[i].first];
+        float scale = scales[m_contexts[i].first];
+        for (int j = static_cast<int>(figure.getTransformations().size()) - 1; j > -1; j--) {
+            const TransformationId &trId = figure.getTransformations()[j];
+            if (trId.type() == TransformationType::MATRIX) {
+                matr = matr * Render::scene.getMatrixById(trId).inverting();
+                scale *= Render::scene.getMatrixById(trId).maxScale();
+            }
+        }
+        matrices[i] = matr;
+        scales[i] = scale;
+    }
+}
+
+std::vector<RMBound> RMRender::getBounds() const {
+    std::vector<math::matr4> contextMatrices;
+    std::vector<float> contextScales;
+    getContextFrames(contextMatrices, contextScales);
+
+    std::map<std::pair<int, std::vector<float>>, RMBoundingBox> cache;
+    std::vector<RMBound> res;
+    res.reserve(m_boundSlots.size());
+    for (auto &[figIds, context] : m_boundSlots) {
+        const math::matr4 &matr = contextMatrices[context];
+        RMBoundingBox box = getFigureBounds(figIds.front(), matr, cache);
+        for (auto it = figIds.begin() + 1; it != figIds.end(); it++) {
+            RMBoundingBox other = getFigureBounds(*it, matr, cache);
+            box.min = math::vec3::min(box.min, other.min);
+            box.max = math::vec3::max(box.max, other.max);
+            box.maxScale = std::max(box.maxScale, other.maxScale);
+        }
+        if (context != 0) {
+            box = transformBoundingBox(box, matr.inverting());
+            box.maxScale *= contextScales[context];
+        }
+        res.push_back(makeBound(box));
+    }
+    // Empty ssbo is not allowed
+    if (res.empty()) {
+        res.emplace_back();
+    }
+    return res;
+}
+
+std::vector<RMBound> RMRender::getDrawnFigureBounds() const {
+    std::map<std::pair<int, std::vector<float>>, RMBoundingBox> cache;
+    std::vector<RMBound> res;
+    for (auto figId : Render::scene.getScene()) {
+        res.push_back(makeBound(getFigureBounds(figId, math::matr4(), cache)));
+    }
+    // Empty ssbo is not allowed
+    if (res.empty()) {
+        res.emplace_back();
+    }
+    return res;
+}
+
+RMBoundingBox RMRender::getSceneBounds(const std::vector<RMBound> &figureBounds) {
+    RMBoundingBox res{math::vec3(INFINITY), math::vec3(-INFINITY)};
+    for (const RMBound &bound : figureBounds) {
+        math::vec3 cen(bound.cen[0], bound.cen[1], bound.cen[2]);
+        math::vec3 halfSize(bound.halfSize[0], bound.halfSize[1], bound.halfSize[2]);
+        // Hits are found up to the hit threshold stretched by the figure scale (see 'proxy.glsl')
+        halfSize += math::vec3(proxyMargin * bound.maxScale);
+        res.min = math::vec3::min(res.min, cen - halfSize);
+        res.max = math::vec3::max(res.max, cen + halfSize);
+    }
+    return res;
+}
+
+std::vector<PointLight> RMRender::getLights() const {
+    std::vector<PointLight> lights = Render::scene.getLights();
+    for (auto figId : Render::scene.getScene()) {
+        collectEmissiveLights(figId, math::matr4(), lights);
+    }
+    // Empty ssbo is not allowed
+    if (lights.empty()) {
+        lights.push_back({math::vec3(0), math::vec3(0), 0});
+    }
+    return lights;
+}
+
+void RMRender::collectEmissiveLights(const FigureId &id, math::matr4 matr, std::vector<PointLight> &lights) const {
+    FigureScene &scene = Render::scene;
+    const Figure &figure = scene.getFigureById(id);
+    // Lights are placed by matrices only (deformations barely move centers of small light sources)
+    const std::vector<TransformationId> &transforms = figure.getTransformations();
+    for (int i = static_cast<int>(transforms.size()) - 1; i > -1; i--) {
+        if (transforms[i].type() == TransformationType::MATRIX) {
+            matr = scene.getMatrixById(transforms[i]) * matr;
+        }
+    }
+    if (figure.creationType() == CreationType::PRIMITIVE) {
+        PrimitiveId primId = figure.getSourcePrimitive();
+        bool isBox = primId.type() == PrimitiveType::BOX;
+        const Material &mtl = isBox ? scene.getBoxPrimitiveById(primId).mtl : scene.getSpherePrimitiveById(primId).mtl;
+        if (mtl.is_light_source) {
+            // Light is in the primitive center, shadow rays end at its bounding sphere
+            float radius = isBox ? scene.getBoxPrimitiveById(primId).size * std::sqrt(3.f) / 2 : scene.getSpherePrimitiveById(primId).radius;
+            lights.push_back(
+                {matr.transformPoint(math::vec3(0)), math::vec3(mtl.r, mtl.g, mtl.b), emissiveLightRange, radius * matr.maxScale()}
+            );
+        }
+        return;
+    }
+    // Subtracted figure is never seen, repetition gives the light of its source copy only
+    const std::vector<FigureId> &sources = figure.getSourceFigures();
+    size_t count = figure.creationType() == CreationType::SUBTRACTION ? 1 : sources.size();
+    for (size_t i = 0; i < count; i++) {
+        collectEmissiveLights(sources[i], matr, lights);
+    }
+}
+
+std::vector<uint> RMRender::getLightClusters(const std::vector<PointLight> &lights) const {
+    const int cells = lightGridSize * lightGridSize * lightGridSize;
+    std::vector<std::vector<uint>> cellLights(cells);
+    // Shaded points are on drawn figures, so the grid covers their box only
+    const float boxMin[3] = {m_sceneBounds.min.x, m_sceneBounds.min.y, m_sceneBounds.min.z};
+    const float boxMax[3] = {m_sceneBounds.max.x, m_sceneBounds.max.y, m_sceneBounds.max.z};
+    float cellSize[3];
+    for (int a = 0; a < 3; a++) {
+        cellSize[a] = (boxMax[a] - boxMin[a]) / lightGridSize;
+    }
+    for (size_t i = 0; i < lights.size() && !Render::scene.getScene().empty(); i++) {
+        const PointLight &light = lights[i];
+        float range = light.color[3];
+        if (range <= 0 || (light.color[0] <= 0 && light.color[1] <= 0 && light.color[2] <= 0)) {
+            continue;
+        }
+        // Cells of the box of the light sphere
+        int lo[3], hi[3];
+        for (int a = 0; a < 3; a++) {
+            lo[a] = static_cast<int>(std::max(std::floor((light.pos[a] - range - boxMin[a]) / cellSize[a]), 0.f));
+            hi[a] = static_cast<int>(std::min(std::floor((light.pos[a] + range - boxMin[a]) / cellSize[a]), lightGridSize - 1.f));
+        }
+        for (int z = lo[2]; z <= hi[2]; z++) {
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                for (int x = lo[0]; x <= hi[0]; x++) {
+                    // Distance from the light to the nearest point of the cell
+                    const int cell[3] = {x, y, z};
+                    float dist2 = 0;
+                    for (int a = 0; a < 3; a++) {
+                        float cellMin = boxMin[a] + cell[a] * cellSize[a];
+                        float d = std::max({cellMin - light.pos[a], light.pos[a] - cellMin - cellSize[a], 0.f});
+                        dist2 += d * d;
+                    }
+                    if (dist2 <= range * range) {
+                        cellLights[(z * lightGridSize + y) * lightGridSize + x].push_back(static_cast<uint>(i));
+                    }
+                }
+            }
+        }
+    }
+    // Offsets of the cells (the last one ends the indices), then the indices (see 'LightClusterBuffer' of rm shader)
+    std::vector<uint> res(cells + 1);
+    for (int i = 0; i < cells; i++) {
+        res[i + 1] = res[i] + static_cast<uint>(cellLights[i].size());
+    }
+    for (const std::vector<uint> &indices : cellLights) {
+        res.insert(res.end(), indices.begin(), indices.end());
+    }
+    // Runtime array of indices must not be empty
+    res.push_back(0);
+    return res;
+}
+
+std::vector<RMBound> RMRender::getMotionBounds(const std::vector<RMBound> &figureBounds) {
+    FigureScene &scene = Render::scene;
+    // Shapes inside bounds are unknown if deformations or topology are changed
+    m_isSceneChanged = m_motionRevision != scene.getRevision() || m_prevFigureBounds.size() != figureBounds.size() ||
+                       !isSameData(m_prevTwistings, scene.getTwistings()) || !isSameData(m_prevBendings, scene.getBendings()) ||
+                       !isSameData(m_prevRepeats, scene.getRepeats());
+    m_motionRevision = scene.getRevision();
+    m_prevTwistings = scene.getTwistings();
+    m_prevBendings = scene.getBendings();
+    m_prevRepeats = scene.getRepeats();
+
+    const std::vector<math::matr4> &matrices = scene.getMatrices();
+    std::vector<bool> isMatrixChanged(matrices.size(), true);
+    for (size_t i = 0; i < matrices.size() && i < m_prevMatrices.size(); i++) {
+        isMatrixChanged[i] = std::memcmp(&matrices[i], &m_prevMatrices[i], sizeof(math::matr4)) != 0;
+    }
+    m_prevMatrices = matrices;
+
+    std::vector<RMBound> res;
+    if (!m_isSceneChanged) {
+        int i = 0;
+        for (auto figId : scene.getScene()) {
+            const RMBound &prev = m_prevFigureBounds[i], &cur = figureBounds[i];
+            i++;
+            // Rotation could keep the bounds
+            if (std::memcmp(prev.cen, cur.cen, sizeof(prev.cen)) == 0 && std::memcmp(prev.halfSize, cur.halfSize, sizeof(prev.halfSize)) == 0 &&
+                !isMoved(scene.getFigureById(figId), isMatrixChanged)) {
+                continue;
+            }
+            // Box swept by the figure since the previous frame
+            math::vec3 prevCen(prev.cen[0], prev.cen[1], prev.cen[2]);
+            math::vec3 prevHalfSize(prev.halfSize[0], prev.halfSize[1], prev.halfSize[2]);
+            math::vec3 curCen(cur.cen[0], cur.cen[1], cur.cen[2]);
+            math::vec3 curHalfSize(cur.halfSize[0], cur.halfSize[1], cur.halfSize[2]);
+            RMBoundingBox box;
+            box.min = math::vec3::min(prevCen - prevHalfSize, curCen - curHalfSize);
+            box.max = math::vec3::max(prevCen + prevHalfSize, curCen + curHalfSize);
+            res.push_back(makeBound(box));
+        }
+    }
+    m_prevFigureBounds = figureBounds;
+    // Empty ssbo is not allowed, box with negative size is never hit
+    if (res.empty()) {
+        RMBound bound;
+        bound.halfSize[0] = bound.halfSize[1] = bound.halfSize[2] = -1;
+        res.push_back(bound);
+    }
+    return res;
+}
+
+int RMRender::getContext(int parentContext, int figureId) {
+    auto contextKey = std::make_pair(parentContext, figureId);
+    auto it = m_contextIds.find(contextKey);
+    if (it == m_contextIds.end()) {
+        it = m_contextIds.emplace(contextKey, static_cast<int>(m_contexts.size())).first;
+        m_contexts.push_back(contextKey);
+    }
+    return it->second;
+}
+
+int RMRender::getLipschitzSlot(int figureId, int context) {
+    auto slotKey = std::make_pair(figureId, context);
+    auto it = m_lipschitzSlotIds.find(slotKey);
+    if (it == m_lipschitzSlotIds.end()) {
+        it = m_lipschitzSlotIds.emplace(slotKey, static_cast<int>(m_lipschitzSlots.size())).first;
+        m_lipschitzSlots.push_back(slotKey);
+    }
+    return it->second;
+}
+
+std::vector<float> RMRender::getLipschitzBounds() const {
+    std::vector<math::matr4> contextMatrices;
+    std::vector<float> contextScales;
+    getContextFrames(contextMatrices, contextScales);
+
+    std::map<std::pair<int, std::vector<float>>, RMBoundingBox> cache;
+    std::vector<float> res;
+    res.reserve(m_lipschitzSlots.size());
+    for (auto &[figId, context] : m_lipschitzSlots) {
+        res.push_back(getFigureBounds(figId, contextMatrices[context], cache).lipschitz);
+    }
+    // Empty ssbo is not allowed
+    if (res.empty()) {
+        res.push_back(1);
+    }
+    return res;
+}
+
+RMBoundingBox RMRender::getFigureBounds(
+    const FigureId &id,
+    const math::matr4 &matr,
+    std::map<std::pair<int, std::vector<float>>, RMBoundingBox> &cache
+) const {
+    FigureScene &scene = Render::scene;
+    const Figure &figure = scene.getFigureById(id);
+    const std::vector<TransformationId> &transforms = figure.getTransformations();
+
+    auto key = std::make_pair(id.id(), std::vector<float>(&matr.matrix[0][0], &matr.matrix[0][0] + 16));
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    // World to frame matrices before every transformation (frames[i] - frame of i-th transformation result)
+    std::vector<math::matr4> frames(transforms.size() + 1);
+    frames[transforms.size()] = matr;
+    for (int i = static_cast<int>(transforms.size()) - 1; i > -1; i--) {
+        frames[i] = frames[i + 1];
+        if (transforms[i].type() == TransformationType::MATRIX) {
+            frames[i] = frames[i] * scene.getMatrixById(transforms[i]).inverting();
+        }
+    }
+
+    RMBoundingBox box;
+    if (figure.creationType() == CreationType::PRIMITIVE) {
+        PrimitiveId primId = figure.getSourcePrimitive();
+        float halfSize = 0;
+        if (primId.type() == PrimitiveType::BOX) {
+            halfSize = scene.getBoxPrimitiveById(primId).size / 2;
+        } else if (primId.type() == PrimitiveType::SPHERE) {
+            halfSize = scene.getSpherePrimitiveById(primId).radius;
+        }
+        box = {math::vec3(-halfSize), math::vec3(halfSize)};
+    } else {
+        std::vector<FigureId> sources = figure.getSourceFigures();
+        box = getFigureBounds(sources.front(), frames[0], cache);
+        for (auto src = sources.begin() + 1; src != sources.end(); src++) {
+            if (figure.creationType() == CreationType::SUBTRACTION) {
+                break;
+            }
+            RMBoundingBox other = getFigureBounds(*src, frames[0], cache);
+            box.maxScale = std::max(box.maxScale, other.maxScale);
+            if (figure.creationType() == CreationType::INTERSECTION) {
+                box.min = math::vec3::max(box.min, other.min);
+                box.max = math::vec3::max(box.min, math::vec3::min(box.max, other.max));
+            } else {
+                box.min = math::vec3::min(box.min, other.min);
+                box.max = math::vec3::max(box.max, other.max);
+            }
+        }
+        // Smooth union may bulge out of its operands by at most k / 4
+        if (figure.creationType() == CreationType::SUNION) {
+            box.min -= math::vec3(smoothK / 4);
+            box.max += math::vec3(smoothK / 4);
+        }
+        // Copies are placed around the source figure
+        if (figure.creationType() == CreationType::REPEAT) {
+            const RepeatParameters &repeat = scene.getRepeats()[figure.getRepeatId()];
+            math::vec3 extent(
+                (repeat.count[0] - 1) / 2 * repeat.period[0], (repeat.count[1] - 1) / 2 * repeat.period[1],
+                (repeat.count[2] - 1) / 2 * repeat.period[2]
+            );
+            box.min -= extent;
+            box.max += extent;
+        }
+    }
+
+    // Twist and bend rotate point by angle changing with its position by 'rate' per unit, so distance is stretched
+    // by at most 1 + a (a = rate * radius, radius - max distance to the rotation axis through the frame origin)
+    float lipschitz = 1;
+    math::matr4 inner;  // Matrices applied so far (they move bend parameters to its frame)
+    for (size_t i = 0; i < transforms.size(); i++) {
+        const TransformationId &trId = transforms[i];
+        if (trId.type() == TransformationType::MATRIX) {
+            inner = inner * scene.getMatrixById(trId);
+            box = transformBoundingBox(box, scene.getMatrixById(trId));
+            box.maxScale *= scene.getMatrixById(trId).maxScale();
+            lipschitz *= scene.getMatrixById(trId).inverting().maxScale();
+            continue;
+        }
+        float radius = !math::vec3::max(box.max, -box.min);
+        float stretch = 1;
+        if (trId.type() == TransformationType::TWIST) {
+            // Twist direction is moved to the frame without normalization (see 'twist' in rm shader).
+            // Angle changes along the rotation axis only, so stretch is the one of shear by a
+            const TransformationTwist &twist = scene.getTransformationTwistById(trId);
+            float a = std::abs(twist.intensity) * frames[i + 1].maxScale() * radius;
+            stretch = (a + std::sqrt(a * a + 4)) / 2;
+        } else if (trId.type() == TransformationType::BEND) {
+            // Bend parameters are moved to the frame by inner matrices without normalization (see 'bend' in rm shader).
+            // Angle is the one around the axis through the center orthogonal to 'rad' and 'right', so it changes
+            // by 1 / distance to this axis times ratio of their lengths (unbounded when figure reaches the axis)
+            const TransformationBend &bend = scene.getTransformationBendById(trId);
+            math::vec3 origin = inner.transformPoint(math::vec3(0));
+            math::vec3 cen = inner.transformPoint(math::vec3(bend.pos[0], bend.pos[1], bend.pos[2]));
+            math::vec3 dir =
+                inner.transformPoint(math::vec3(bend.dir[0], bend.dir[1], bend.dir[2]).normalizing()) - origin;
+            math::vec3 rad =
+                inner.transformPoint(math::vec3(bend.rad[0], bend.rad[1], bend.rad[2]).normalizing()) - origin;
+            math::vec3 right = rad % dir;
+            float radLen = !rad, rightLen = !right;
+            stretch = bendAxisStretch;
+            if (radLen > 0 && rightLen > 0) {
+                math::vec3 axis = (right % rad).normalizing();
+                float axisDist = !(cen - axis * (cen & axis)) - radius;
+                if (axisDist > 0) {
+                    stretch = 1 + std::max(radLen, rightLen) / std::min(radLen, rightLen) * radius / axisDist;
+                }
+            }
+        }
+        box = rotateBoundingBox(box);
+        box.maxScale *= stretch;
+        lipschitz *= stretch;
+    }
+    // Distance of deformed figure is divided by its Lipschitz bound (see 'serializeFigure')
+    box.lipschitz = lipschitz;
+    if (isDeformed(figure)) {
+        box.maxScale *= lipschitz;
+    }
+    cache.emplace(key, box);
+    return box;
+}
+
+std::string RMRender::getMatrixLiteral(const math::matr4 &matr) {
+    // Column-major as in ssbo, digits enough to restore exactly the same floats
+    std::ostringstream literal;
+    literal.precision(std::numeric_limits<float>::max_digits10);
+    literal << "mat4(";
+    for (int i = 0; i < 16; i++) {
+        literal << (i == 0 ? "" : ", ") << matr.matrix[i / 4][i % 4];
+    }
+    literal << ")";
+    return literal.str();
+}
+
+std::string RMRender::emitVariable(const std::string &type, const std::string &expression) {
+    std::string key = type + ' ' + expression;
+    auto it = m_variables.find(key);
+    if (it != m_variables.end()) {
+        return it->second;
+    }
+    std::string name = emitUniqueVariable(type, expression);
+    m_variables.emplace(key, name);
+    m_variablesLog.push_back(key);
+    return name;
+}
+
+std::string RMRender::emitUniqueVariable(const std::string &type, const std::string &expression) {
+    std::string name = "v" + std::to_string(m_variablesCount++);
+    emitLine({type, " ", name, " = ", expression, ";"});
+    return name;
+}
+
+void RMRender::emitLine(std::initializer_list<std::string_view> parts) {
+    m_sceneSource += m_indent;
+    for (std::string_view part : parts) {
+        m_sceneSource += part;
+    }
+    m_sceneSource += '\n';
+}
+
+void RMRender::openScope() {
+    m_scopes.emplace_back(m_variablesLog.size(), m_serializedFiguresLog.size());
+    m_indent += '\t';
+}
+
+void RMRender::closeScope() {
+    auto [variablesCount, figuresCount] = m_scopes.back();
+    m_scopes.pop_back();
+    m_indent.pop_back();
+    for (size_t i = variablesCount; i < m_variablesLog.size(); i++) {
+        m_variables.erase(m_variablesLog[i]);
+    }
+    m_variablesLog.resize(variablesCount);
+    for (size_t i = figuresCount; i < m_serializedFiguresLog.size(); i++) {
+        m_serializedFigures.erase(m_serializedFiguresLog[i]);
+    }
+    m_serializedFiguresLog.resize(figuresCount);
+}
+
+void RMRender::collectOperands(const std::vector<FigureId> &sources, CreationType type, std::vector<FigureId> &operands) const {
+    // Explicit stack (chains built by '|=' may be very deep)
+    std::vector<FigureId> stack(sources.rbegin(), sources.rend());
+    while (!stack.empty()) {
+        FigureId id = stack.back();
+        stack.pop_back();
+        const Figure &figure = Render::scene.getFigureById(id);
+        if (figure.creationType() == type && figure.getTransformations().empty()) {
+            std::vector<FigureId> figureSources = figure.getSourceFigures();
+            stack.insert(stack.end(), figureSources.rbegin(), figureSources.rend());
+        } else {
+            operands.push_back(id);
+        }
+    }
+}
+
+const char *RMRender::getOperationName(CreationType type) {
+    switch (type) {
+        case CreationType::UNION:
+            return "unite";
+        case CreationType::SUNION:
+            return "sunite";
+        case CreationType::INTERSECTION:
+            return "inter";
+        case CreationType::SUBTRACTION:
+            return "sub";
+        default:
+            return nullptr;
+    }
+}
+
+FigureId RMRender::getFirstOperand(const std::vector<FigureId> &sources, CreationType type) const {
+    FigureScene &scene = Render::scene;
+    FigureId first = sources.front();
+    if (scene.isBalancing() && (type == CreationType::UNION || type == CreationType::INTERSECTION)) {
+        while (true) {
+            const Figure &figure = scene.getFigureById(first);
+            if (figure.creationType() != type || !figure.getTransformations().empty()) {
+                break;
+            }
+            first = figure.getSourceFigures().front();
+        }
+    }
+    return first;
+}
+
+std::string RMRender::serializeOperation(
+    CreationType type,
+    const std::vector<FigureId> &sources,
+    const std::string &pos,
+    const std::string &matr,
+    int context
+) {
+    FigureScene &scene = Render::scene;
+    const std::string operationName = getOperationName(type);
+
+    // Chain of first operands (built by '|=', '/=', etc.) is serialized from its end without deep recursion:
+    // every figure of the chain finds its first operand already serialized
+    std::vector<FigureId> chain;
+    for (FigureId first = getFirstOperand(sources, type);;) {
+        const Figure &figure = scene.getFigureById(first);
+        if (getOperationName(figure.creationType()) == nullptr || !figure.getTransformations().empty() ||
+            m_serializedFigures.count(std::make_tuple(first.id(), pos, matr))) {
+            break;
+        }
+        chain.push_back(first);
+        first = getFirstOperand(figure.getSourceFigures(), figure.creationType());
+    }
+    for (auto it = chain.rbegin(); it != chain.rend(); it++) {
+        serializeFigureId(*it, pos, matr, context);
+    }
+
+    // Union and intersection are associative, so their chains are rebalanced
+    // (log depth and every half of the chain is guarded by its bounds)
+    if (scene.isBalancing() && (type == CreationType::UNION || type == CreationType::INTERSECTION)) {
+        std::vector<FigureId> operands;
+        collectOperands(sources, type, operands);
+        return serializeBalancedOperation(operationName, operands.begin(), operands.end(), pos, matr, context);
+    }
+    std::string res = serializeFigureId(sources.front(), pos, matr, context);
     for (auto it = sources.begin() + 1; it != sources.end(); it++) {
-        res = operationName + "(" + res + ", " + serializeFigureId(*it, pos, matr) + ")";
+        res = serializeOperand(operationName, res, it, it + 1, pos, matr, context);
     }
     return res;
 }
 
-// TODO maybe ref??
-std::string RMRender::serializeFigureId(const FigureId &id, std::string pos, std::string matr) {
+std::string RMRender::serializeBalancedOperation(
+    const std::string &operationName,
+    std::vector<FigureId>::const_iterator begin,
+    std::vector<FigureId>::const_iterator end,
+    const std::string &pos,
+    const std::string &matr,
+    int context
+) {
+    if (end - begin == 1) {
+        return serializeFigureId(*begin, pos, matr, context);
+    }
+    auto middle = begin + (end - begin) / 2;
+    std::string res = serializeBalancedOperation(operationName, begin, middle, pos, matr, context);
+    return serializeOperand(operationName, res, middle, end, pos, matr, context);
+}
+
+std::string RMRender::serializeOperand(
+    const std::string &operationName,
+    const std::string &res,
+    std::vector<FigureId>::const_iterator begin,
+    std::vector<FigureId>::const_iterator end,
+    const std::string &pos,
+    const std::string &matr,
+    int context
+) {
+    FigureScene &scene = Render::scene;
+
+    // Operand is evaluated only if it can change the result
+    // (its bounds distance is a lower estimation of its sdf)
+    std::string condition;
+    if (operationName == "unite") {
+        condition = " <= " + res + getDistanceField();
+    } else if (operationName == "sunite") {
+        condition = " <= " + res + getDistanceField() + " + smooth_k";
+    } else if (operationName == "sub") {
+        condition = " < -" + res + getDistanceField();
+    }
+    // Not worth guarding (guard costs the same as a primitive),
+    // bounds inside of repetition are unknown (they depend on the cell),
+    // frames inside of twisting and bending are not affine (context frames have matrices only)
+    const Figure &figure = scene.getFigureById(*begin);
+    if (m_repeatDepth > 0 || m_deformedDepth > 0) {
+        condition.clear();
+    } else if (end - begin == 1 && figure.creationType() == CreationType::PRIMITIVE &&
+        std::all_of(figure.getTransformations().begin(), figure.getTransformations().end(), [](const TransformationId &trId) {
+            return trId.type() == TransformationType::MATRIX;
+        })) {
+        condition.clear();
+    }
+
+    if (condition.empty()) {
+        std::string operand = serializeBalancedOperation(operationName, begin, end, pos, matr, context);
+        return emitVariable(getSurfaceType(), operationName + "(" + res + ", " + operand + ")");
+    }
+    std::vector<int> figIds;
+    for (auto it = begin; it != end; it++) {
+        figIds.push_back(it->id());
+    }
+    auto slotKey = std::make_pair(std::move(figIds), context);
+    auto slot = m_boundSlotIds.find(slotKey);
+    if (slot == m_boundSlotIds.end()) {
+        slot = m_boundSlotIds.emplace(slotKey, static_cast<int>(m_boundSlots.size())).first;
+        m_boundSlots.push_back(slotKey);
+    }
+    std::string guarded = emitUniqueVariable(getSurfaceType(), res);
+    emitLine({"if (bound_dist(p, bounds_buffer.bounds[", std::to_string(slot->second), "])", condition, ") {"});
+    openScope();
+    std::string operand = serializeBalancedOperation(operationName, begin, end, pos, matr, context);
+    emitLine({guarded, " = ", operationName, "(", res, ", ", operand, ");"});
+    closeScope();
+    emitLine({"}"});
+    return guarded;
+}
+
+int RMRender::getRepeatNeighbourAxes(const Figure &figure) const {
+    FigureScene &scene = Render::scene;
+    const RepeatParameters &repeat = scene.getRepeats()[figure.getRepeatId()];
+    const Figure &source = scene.getFigureById(figure.getSourceFigures().front());
+
+    int axes = 0;
+    for (int i = 0; i < 3; i++) {
+        if (repeat.count[i] > 1) {
+            axes |= 1 << i;
+        }
+    }
+    // Primitive is symmetric, so if it fits in its cell, the nearest copy is the closest one
+    if (source.creationType() == CreationType::PRIMITIVE && source.getTransformations().empty()) {
+        PrimitiveId primId = source.getSourcePrimitive();
+        float halfSize = primId.type() == PrimitiveType::BOX ? scene.getBoxPrimitiveById(primId).size / 2
+                                                             : scene.getSpherePrimitiveById(primId).radius;
+        bool isInCell = true;
+        for (int i = 0; i < 3; i++) {
+            if ((axes & 1 << i) && halfSize > repeat.period[i] / 2) {
+                isInCell = false;
+            }
+        }
+        if (isInCell) {
+            return 0;
+        }
+    }
+    return axes;
+}
+
+std::string RMRender::serializeRepeat(const Figure &figure, const std::string &pos, const std::string &matr, int context) {
+    std::string repeat = "repeat_buffer.repeats[" + std::to_string(figure.getRepeatId()) + "]";
+    FigureId source = figure.getSourceFigures().front();
+    int axes = getRepeatNeighbourAxes(figure);
+
+    // Neighbour cell bits are taken from the loop counter (one bit for every checked axis)
+    std::string counter = "i" + std::to_string(m_variablesCount++);
+    std::string neighbour = "vec3(0)";
+    int cellsCount = 1;
+    if (axes != 0) {
+        neighbour = "vec3(";
+        for (int i = 0, bit = 0; i < 3; i++) {
+            neighbour += i == 0 ? "" : ", ";
+            if (axes & 1 << i) {
+                neighbour += "(" + counter + " >> " + std::to_string(bit++) + ") & 1";
+                cellsCount *= 2;
+            } else {
+                neighbour += "0";
+            }
+        }
+        neighbour += ")";
+    }
+
+    std::string res;
+    if (axes != 0) {
+        res = emitUniqueVariable(
+            getSurfaceType(), m_isDistanceOnly ? "max_dist" : "Surface(Material(vec4(0), 0), max_dist)"
+        );
+        emitLine({"for (int ", counter, " = 0; ", counter, " < ", std::to_string(cellsCount), "; ", counter, "++) {"});
+        openScope();
+    }
+    m_repeatDepth++;
+    std::string cell = emitVariable("vec3", "repeat_cell(" + pos + ", " + repeat + ", " + neighbour + ")");
+    std::string cellPos = emitVariable("vec4", "vec4(" + pos + ".xyz - " + cell + ", " + pos + ".w)");
+    std::string cellMatr = emitVariable("mat4", "mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -" + cell + ", 1) * " + matr);
+    std::string copy = serializeFigureId(source, cellPos, cellMatr, context);
+    m_repeatDepth--;
+    if (axes == 0) {
+        return copy;
+    }
+    emitLine({res, " = unite(", res, ", ", copy, ");"});
+    closeScope();
+    emitLine({"}"});
+    return res;
+}
+
+std::string RMRender::serializeFigureId(const FigureId &id, const std::string &pos, const std::string &matr, int context) {
+    // Figure may be referenced several times (DAG), so each (figure, position) pair is emitted once
+    auto key = std::make_tuple(id.id(), pos, matr);
+    auto it = m_serializedFigures.find(key);
+    if (it != m_serializedFigures.end()) {
+        return it->second;
+    }
+    std::string res = serializeFigure(id, pos, matr, context);
+    m_serializedFigures.emplace(key, res);
+    m_serializedFiguresLog.push_back(key);
+    return res;
+}
+
+std::string RMRender::serializeFigure(const FigureId &id, std::string pos, std::string matr, int context) {
     FigureScene &scene = Render::scene;
     const Figure &figure = scene.getFigureById(id);
 
+    int parentContext = context;
+    if (!figure.getTransformations().empty()) {
+        context = getContext(parentContext, id.id());
+    }
+
     for (int i = figure.getTransformations().size() - 1; i > -1; i--) {
         auto &trId = figure.getTransformations()[i];
         if (trId.type() == TransformationType::MATRIX) {
-            pos = "inverse(matrices_buffer.matrices[" + std::to_string(trId.id()) + "]) * " + pos;
-            matr = "inverse(matrices_buffer.matrices[" + std::to_string(trId.id()) + "]) * " + matr;
+            auto last = figure.getTransformations().begin() + i + 1;
+            std::vector<int> chain = getMatrixChain(figure, i);
+            std::string inv;
+            if (std::all_of(figure.getTransformations().begin() + i, last, [&scene](const TransformationId &id) {
+                    return scene.isStaticMatrix(id);
+                })) {
+                // Static chain can't change, so it is baked into the shader (no slot in inverse matrices ssbo)
+                inv = emitVariable("const mat4", getMatrixLiteral(getMatrixChainInverse(chain)));
+            } else {
+                inv = "inverse_matrices_buffer.matrices[" + std::to_string(getMatrixChainSlot(chain)) + "]";
+            }
+            pos = emitVariable("vec4", inv + " * " + pos);
+            matr = emitVariable("mat4", inv + " * " + matr);
         } else if (trId.type() == TransformationType::BEND) {
+            // Bend parameters are given in the figure frame, so they are moved by all matrices applied before it
+            std::vector<int> chain = getInnerMatrixChain(figure, i);
             std::string m = "mat4(1)";
-            for (int j = 0; j < i; j++) {
-                auto &trId2 = figure.getTransformations()[j];
-                if (figure.getTransformations()[i].type() == TransformationType::MATRIX) {
-                    m = m + "* matrices_buffer.matrices[" + std::to_string(trId2.id()) + "]";
+            if (!chain.empty()) {
+                auto first = figure.getTransformations().begin();
+                if (std::all_of(first, first + i, [&scene](const TransformationId &id) {
+                        return id.type() != TransformationType::MATRIX || scene.isStaticMatrix(id);
+                    })) {
+                    m = emitVariable("const mat4", getMatrixLiteral(getMatrixChainProduct(chain)));
+                } else {
+                    m = "inverse_matrices_buffer.matrices[" + std::to_string(getMatrixChainSlot(chain, false)) + "]";
                 }
             }
-            pos = "bend(" + pos + ", " + m + ", bend_buffer.bends[" + std::to_string(trId.id()) + "])";
+            pos = emitVariable("vec4", "bend(" + pos + ", " + m + ", bend_buffer.bends[" + std::to_string(trId.id()) + "])");
         } else if (trId.type() == TransformationType::TWIST) {
-            std::string m = "mat4(1)";
-            for (int j = 0; j < i; j++) {
-                auto &trId2 = figure.getTransformations()[j];
-                if (figure.getTransformations()[i].type() == TransformationType::MATRIX) {
-                    m = m + "* matrices_buffer.matrices[" + std::to_string(trId2.id()) + "]";
-                }
-            }
-            pos = "twist(" + pos + ", " + matr + ", twist_buffer.twists[" + std::to_string(trId.id()) + "])";
+            pos = emitVariable("vec4", "twist(" + pos + ", " + matr + ", twist_buffer.twists[" + std::to_string(trId.id()) + "])");
         }
     }
+    bool isFigureDeformed = isDeformed(figure);
+    m_deformedDepth += isFigureDeformed;
+    std::string res = "0";
     if (figure.creationType() == CreationType::PRIMITIVE) {
         PrimitiveId primId = figure.getSourcePrimitive();
         if (primId.type() == PrimitiveType::BOX) {
-            return "SDF_box(" + pos + ", box_buffer.boxes[" + std::to_string(primId.id()) + "])";
+            res = emitVariable(getSurfaceType(), std::string(getPrimitivePrefix()) + "box(" + pos + ", box_buffer.boxes[" + std::to_string(primId.id()) + "])");
         } else if (primId.type() == PrimitiveType::SPHERE) {
-            return "SDF_sphere(" + pos + ", sphere_buffer.spheres[" + std::to_string(primId.id()) + "])";
+            res = emitVariable(getSurfaceType(), std::string(getPrimitivePrefix()) + "sphere(" + pos + ", sphere_buffer.spheres[" + std::to_string(primId.id()) + "])");
         }
-    } else if (figure.creationType() == CreationType::INTERSECTION) {
-        std::vector<FigureId> sources = figure.getSourceFigures();
-        return serializeOperation("inter", sources, pos, matr);
-    } else if (figure.creationType() == CreationType::UNION) {
-        std::vector<FigureId> sources = figure.getSourceFigures();
-        return serializeOperation("unite", sources, pos, matr);
-    } else if (figure.creationType() == CreationType::SUBTRACTION) {
-        std::vector<FigureId> sources = figure.getSourceFigures();
-        return serializeOperation("sub", sources, pos, matr);
-    } else if (figure.creationType() == CreationType::SUNION) {
-        std::vector<FigureId> sources = figure.getSourceFigures();
-        return serializeOperation("sunite", sources, pos, matr);
+    } else if (figure.creationType() == CreationType::REPEAT) {
+        res = serializeRepeat(figure, pos, matr, context);
+    } else if (getOperationName(figure.creationType()) != nullptr) {
+        res = serializeOperation(figure.creationType(), figure.getSourceFigures(), pos, matr, context);
     }
-    return "0";
-
+    m_deformedDepth -= isFigureDeformed;
+    // Only deformed subtree takes shorter steps
+    if (isFigureDeformed) {
+        int slot = getLipschitzSlot(id.id(), parentContext);
+        res = emitVariable(getSurfaceType(), "lipschitz_scale(" + res + ", lipschitz_buffer.lipschitz[" + std::to_string(slot) + "])");
+    }
+    return res;
 }
 
 std::string RMRender::getSDFSceneSource() {
@@ -198,22 +1808,211 @@ std::string RMRender::getSDFSceneSource() {
     for (auto figId : scene.getScene()) {
         for_draw.push_back(figId);
     }
-    std::string res =\
-        "Surface SDF_scene(vec3 p)\n"
+    // Previous source size is a good estimation for regeneration after small edits
+    m_sceneSource.clear();
+    m_sceneSource.reserve(m_sceneSourceCapacity);
+    m_matrixChains.clear();
+    m_matrixChainSlots.clear();
+    m_contexts.assign(1, {-1, -1});
+    m_contextIds.clear();
+    m_boundSlots.clear();
+    m_boundSlotIds.clear();
+    m_lipschitzSlots.clear();
+    m_lipschitzSlotIds.clear();
+    // Materials are needed only at hit points, all other queries use distance only function
+    // (both functions share slots, so the second one finds them already created)
+    serializeSceneFunction(for_draw, false);
+    serializeSceneFunction(for_draw, true);
+    if (m_isCompute) {
+        serializeFigureDistances(for_draw);
+    }
+    m_sceneSourceCapacity = m_sceneSource.size();
+    return std::move(m_sceneSource);
+}
+
+void RMRender::serializeSceneFunction(const std::vector<FigureId> &figures, bool isDistanceOnly) {
+    m_isDistanceOnly = isDistanceOnly;
+    if (isDistanceOnly) {
+        m_sceneSource +=
+            "float SDF_dist(vec3 p)\n"
+            "{\n"
+            "\tvec4 pos = vec4(p.xyz, 1);\n"
+            "\tfloat res = max_dist;\n";
+    } else {
+        m_sceneSource +=
+            "Surface SDF_scene(vec3 p)\n"
+            "{\n"
+            "\tvec4 pos = vec4(p.xyz, 1);\n"
+            "\tSurface res;\n";
+    }
+    m_indent = "\t";
+    m_variablesCount = 0;
+    m_variables.clear();
+    m_serializedFigures.clear();
+    m_variablesLog.clear();
+    m_serializedFiguresLog.clear();
+    if (!figures.empty()) {
+        std::string res = serializeOperation(CreationType::UNION, figures, "pos", "mat4(1)", 0);
+        emitLine({"res = ", res, ";"});
+    }
+    emitLine({"return res;"});
+    m_sceneSource += "}\n";
+}
+
+void RMRender::serializeFigureDistances(const std::vector<FigureId> &figures) {
+    m_isDistanceOnly = true;
+    m_sceneSource +=
+        "float SDF_figure_dist(int figure, vec3 p)\n"
         "{\n"
-        "\tvec4 pos = vec4(p.xyz, 1);"
-        "\tSurface res;\n";
-    if (!for_draw.empty()) {
-        res += "\tres = ";
-        res += serializeOperation("unite", for_draw, "pos", "mat4(1)");
-        res += ";\n";
-    }
-    res += "\treturn res;\n"
-           "}\n";
-    return res;
+        "\tvec4 pos = vec4(p.xyz, 1);\n"
+        "\tfloat res = max_dist;\n"
+        "\tswitch (figure) {\n";
+    m_indent = "\t";
+    m_variablesCount = 0;
+    m_variables.clear();
+    m_serializedFigures.clear();
+    m_variablesLog.clear();
+    m_serializedFiguresLog.clear();
+    for (size_t i = 0; i < figures.size(); i++) {
+        emitLine({"case ", std::to_string(i), ": {"});
+        openScope();
+        std::string res = serializeFigureId(figures[i], "pos", "mat4(1)", 0);
+        emitLine({"res = ", res, ";"});
+        emitLine({"break;"});
+        closeScope();
+        emitLine({"}"});
+    }
+    emitLine({"}"});
+    emitLine({"return res;"});
+    m_sceneSource += "}\n";
+}
+
+void RMRender::serializeFigureIdBytecode(
+    const FigureId &id,
+    std::vector<RMInstruction> &program,
+    int posDepth,
+    int &maxPosDepth,
+    int &surfaceDepth,
+    int &maxSurfaceDepth,
+    int context
+) {
+    FigureScene &scene = Render::scene;
+    const Figure &figure = scene.getFigureById(id);
+    const std::vector<TransformationId> &transforms = figure.getTransformations();
+
+    // Lipschitz bound depends on the frame of the figure, so contexts are the same as in 'serializeFigure'
+    int parentContext = context;
+    if (!transforms.empty()) {
+        context = getContext(parentContext, id.id());
+        program.push_back({static_cast<int>(RMOpcode::PUSH_POS), 0});
+        maxPosDepth = std::max(maxPosDepth, ++posDepth);
+    }
+    // Same order as in 'serializeFigureId': the last transformation is applied first
+    for (int i = static_cast<int>(transforms.size()) - 1; i > -1; i--) {
+        const TransformationId &trId = transforms[i];
+        if (trId.type() == TransformationType::MATRIX) {
+            program.push_back({static_cast<int>(RMOpcode::MATRIX), getMatrixChainSlot(getMatrixChain(figure, i))});
+        } else if (trId.type() == TransformationType::BEND) {
+            std::vector<int> chain = getInnerMatrixChain(figure, i);
+            if (!chain.empty()) {
+                program.push_back({static_cast<int>(RMOpcode::BEND_MATRIX), getMatrixChainSlot(chain, false)});
+            }
+            program.push_back({static_cast<int>(RMOpcode::BEND), trId.id()});
+        } else if (trId.type() == TransformationType::TWIST) {
+            program.push_back({static_cast<int>(RMOpcode::TWIST), trId.id()});
+        }
+    }
+
+    if (figure.creationType() == CreationType::PRIMITIVE) {
+        PrimitiveId primId = figure.getSourcePrimitive();
+        if (primId.type() == PrimitiveType::BOX) {
+            program.push_back({static_cast<int>(RMOpcode::BOX), primId.id()});
+        } else if (primId.type() == PrimitiveType::SPHERE) {
+            program.push_back({static_cast<int>(RMOpcode::SPHERE), primId.id()});
+        }
+        maxSurfaceDepth = std::max(maxSurfaceDepth, ++surfaceDepth);
+    } else if (figure.creationType() == CreationType::REPEAT) {
+        // Union of the nearest cell and its neighbours along checked axes
+        int axes = getRepeatNeighbourAxes(figure);
+        bool isFirstCell = true;
+        maxPosDepth = std::max(maxPosDepth, posDepth + 1);
+        for (int cell = 0; cell < 8; cell++) {
+            if ((cell & ~axes) != 0) {
+                continue;
+            }
+            program.push_back({static_cast<int>(RMOpcode::PUSH_POS), 0});
+            program.push_back({static_cast<int>(RMOpcode::REPEAT), figure.getRepeatId() * 8 + cell});
+            serializeFigureIdBytecode(
+                figure.getSourceFigures().front(), program, posDepth + 1, maxPosDepth, surfaceDepth, maxSurfaceDepth, context
+            );
+            program.push_back({static_cast<int>(RMOpcode::POP_POS), 0});
+            if (!isFirstCell) {
+                program.push_back({static_cast<int>(RMOpcode::UNION), 0});
+                surfaceDepth--;
+            }
+            isFirstCell = false;
+        }
+    } else {
+        RMOpcode opcode = RMOpcode::UNION;
+        if (figure.creationType() == CreationType::INTERSECTION) {
+            opcode = RMOpcode::INTERSECTION;
+        } else if (figure.creationType() == CreationType::SUBTRACTION) {
+            opcode = RMOpcode::SUBTRACTION;
+        } else if (figure.creationType() == CreationType::SUNION) {
+            opcode = RMOpcode::SUNION;
+        }
+        std::vector<FigureId> sources = figure.getSourceFigures();
+        serializeFigureIdBytecode(sources.front(), program, posDepth, maxPosDepth, surfaceDepth, maxSurfaceDepth, context);
+        for (auto it = sources.begin() + 1; it != sources.end(); it++) {
+            serializeFigureIdBytecode(*it, program, posDepth, maxPosDepth, surfaceDepth, maxSurfaceDepth, context);
+            program.push_back({static_cast<int>(opcode), 0});
+            surfaceDepth--;
+        }
+    }
+
+    if (isDeformed(figure)) {
+        program.push_back({static_cast<int>(RMOpcode::LIPSCHITZ), getLipschitzSlot(id.id(), parentContext)});
+    }
+    if (!transforms.empty()) {
+        program.push_back({static_cast<int>(RMOpcode::POP_POS), 0});
+    }
 }
 
-std::string RMRender::createFragmentSource(const std::string &filePath, const std::string &outPath) {
+std::vector<RMInstruction> RMRender::getSDFSceneProgram() {
+    FigureScene &scene = Render::scene;
+    std::vector<RMInstruction> program;
+    int maxPosDepth = 0, surfaceDepth = 0, maxSurfaceDepth = 0;
+    bool isFirst = true;
+    m_matrixChains.clear();
+    m_matrixChainSlots.clear();
+    // Interpreter has no bounds, contexts give frames of Lipschitz bounds only
+    m_contexts.assign(1, {-1, -1});
+    m_contextIds.clear();
+    m_lipschitzSlots.clear();
+    m_lipschitzSlotIds.clear();
+
+    for (auto figId : scene.getScene()) {
+        serializeFigureIdBytecode(figId, program, 0, maxPosDepth, surfaceDepth, maxSurfaceDepth, 0);
+        if (!isFirst) {
+            program.push_back({static_cast<int>(RMOpcode::UNION), 0});
+            surfaceDepth--;
+        }
+        isFirst = false;
+    }
+    program.push_back({static_cast<int>(RMOpcode::END), 0});
+
+    if (maxPosDepth > bytecodeStackSize || maxSurfaceDepth > bytecodeStackSize) {
+        EXCEPTION("SDF bytecode: figure tree is too deep for interpreter stack");
+    }
+    return program;
+}
+
+std::string RMRender::createFragmentSource(
+    const std::string &filePath,
+    const std::string &outPath,
+    const std::string &sceneSource,
+    ShaderPass pass
+) {
     std::ifstream file(filePath);
     if (!file) {
         // TODO
@@ -221,8 +2020,31 @@ std::string RMRender::createFragmentSource(const std::string &filePath, const st
     std::string sourceLine;
     std::string source;
     while (std::getline(file, sourceLine)) {
-        if (sourceLine == "#include SDF_scene") {
-            source += getSDFSceneSource();
+        if (sourceLine.rfind("#version", 0) == 0) {
+            source += sourceLine + '\n';
+            source += getSharedDefines();
+            source += m_featureDefines;
+            if (pass == ShaderPass::CONE_PREPASS) {
+                // The same shader is compiled as cone prepass
+                source += "#define RM_CONE_PREPASS\n";
+            } else if (pass != ShaderPass::TRACING) {
+                // ... and as deferred lighting passes
+                source += pass == ShaderPass::LIGHTING    ? "#define RM_LIGHTING\n"
+                          : pass == ShaderPass::SECONDARY ? "#define RM_SECONDARY\n"
+                          : pass == ShaderPass::COMPOSITE ? "#define RM_COMPOSITE\n"
+                                                          : "#define RM_STEPS\n";
+            } else if (m_isCompute) {
+                // The same shader is compiled as compute one
+                source += "#define RM_COMPUTE\n";
+            }
+        } else if (sourceLine == "#include SDF_scene") {
+            if (m_isBytecode) {
+                // Interpreter is placed in the shader itself
+                source += "#define SDF_BYTECODE\n";
+                source += "#define SDF_STACK_SIZE " + std::to_string(bytecodeStackSize) + "\n";
+            } else {
+                source += sceneSource;
+            }
         } else {
             source += sourceLine + '\n';
         }
@@ -246,6 +2068,9 @@ std::string RMRender::createVertexSource(const std::string &filePath, const std:
     std::string source;
     while (std::getline(file, sourceLine)) {
         source += sourceLine + '\n';
+        if (sourceLine.rfind("#version", 0) == 0) {
+            source += getSharedDefines();
+        }
     }
 
     /*
@@ -256,4 +2081,69 @@ std::string RMRender::createVertexSource(const std::string &filePath, const std:
     return source;
 }
 
+std::string RMRender::getSharedDefines() {
+    // Floats keep their point and digits enough to restore exactly the same values
+    std::ostringstream defines;
+    defines.precision(std::numeric_limits<float>::max_digits10);
+    defines << std::showpoint;
+    auto define = [&defines](const char *name, auto value) {
+        defines << "#define " << name << ' ' << value << '\n';
+    };
+    define("RM_SMOOTH_K", smoothK);
+    define("RM_PROXY_MARGIN", proxyMargin);
+    define("RM_TILE_SIZE", computeTileSize);
+    define("RM_MAX_TILE_FIGURES", maxTileFigures);
+    define("RM_CONE_BLOCK", coneBlockSize);
+    define("RM_CONE_GROUP_SIZE", coneGroupSize);
+    define("RM_REPROJECT_GROUP_SIZE", reprojectGroupSize);
+    define("RM_DEFERRED_GROUP_SIZE", deferredGroupSize);
+    define("RM_ACCUMULATE_GROUP_SIZE", accumulateGroupSize);
+    define("RM_STEPS_BINS", stepsHistogramSize);
+    define("RM_LIGHT_GRID", lightGridSize);
+    const std::pair<const char *, RMOpcode> opcodes[] = {
+        {"OP_END", RMOpcode::END},
+        {"OP_PUSH_POS", RMOpcode::PUSH_POS},
+        {"OP_POP_POS", RMOpcode::POP_POS},
+        {"OP_MATRIX", RMOpcode::MATRIX},
+        {"OP_TWIST", RMOpcode::TWIST},
+        {"OP_BEND", RMOpcode::BEND},
+        {"OP_SPHERE", RMOpcode::SPHERE},
+        {"OP_BOX", RMOpcode::BOX},
+        {"OP_UNION", RMOpcode::UNION},
+        {"OP_SUNION", RMOpcode::SUNION},
+        {"OP_INTERSECTION", RMOpcode::INTERSECTION},
+        {"OP_SUBTRACTION", RMOpcode::SUBTRACTION},
+        {"OP_REPEAT", RMOpcode::REPEAT},
+        {"OP_LIPSCHITZ", RMOpcode::LIPSCHITZ},
+        {"OP_BEND_MATRIX", RMOpcode::BEND_MATRIX}
+    };
+    for (const auto &[name, opcode] : opcodes) {
+        define(name, static_cast<int>(opcode));
+    }
+    return defines.str();
+}
+
+std::string RMRender::getFeatureDefines() {
+    const std::pair<const char *, RMFeature> features[] = {
+        {"RM_USE_CONE_PREPASS", RMFeature::CONE_PREPASS},
+        {"RM_USE_REPROJECTION", RMFeature::REPROJECTION},
+        {"RM_USE_DEFERRED", RMFeature::DEFERRED},
+        {"RM_USE_PROXIES", RMFeature::PROXIES},
+        {"RM_USE_RASTER_DEPTH", RMFeature::RASTER_DEPTH},
+        {"RM_USE_SCENE_CLIPPING", RMFeature::SCENE_CLIPPING},
+        {"RM_USE_POINT_LIGHTS", RMFeature::POINT_LIGHTS}
+    };
+    std::string defines;
+    for (const auto &[name, feature] : features) {
+        if (Render::scene.isFeature(feature)) {
+            defines += std::string("#define ") + name + '\n';
+        }
+    }
+    // Marching steps are counted only when they are shown (compiler drops the counters otherwise)
+    if (Render::scene.isStepsView()) {
+        defines += "#define RM_COUNT_STEPS\n";
+    }
+    return defines;
+}
+
 }
\ No newline at end of file
@@ -1,16 +1,47 @@
 #ifndef FIGURE_RENDER_HPP
 #define FIGURE_RENDER_HPP
+#include <initializer_list>
+#include <string_view>
 #include "../resources/buffers/buffer.hpp"
 #include "figure_scene.hpp"
 #include "figure.hpp"
 
 namespace hse {
 
+// Marching steps per pixel of one frame (of its primary and secondary rays)
+struct StepStats {
+    float average = 0;
+    int percentile99 = 0;
+};
+
+// Optional features of ray marching renders (shaders get enabled ones they use as 'RM_USE_*' defines, see 'getFeatureDefines'),
+// all are off by default (every frame is traced from the near plane and shaded by the tracing pass)
+enum class RMFeature {
+    CONE_PREPASS,    // Rays start at distances found by cones marched for blocks of pixels
+    REPROJECTION,    // Rays start at hit distances reprojected from the previous frame
+    DEFERRED,        // Tracing pass fills G-buffer lit by deferred passes (surfaces are shaded by tracing pass otherwise)
+    PROXIES,         // Rays are marched only inside rasterized bounding boxes of drawn figures
+    RASTER_DEPTH,    // Rays end at meshes drawn before ray marching (they are hidden by screen depth test otherwise)
+    SCENE_CLIPPING,  // Secondary rays are clipped by the box of all drawn figures
+    REFINEMENT,      // Still frames are not traced again, their jittered samples are accumulated instead
+    POINT_LIGHTS     // Explicit point lights and light source figures light surfaces (binned into clusters of a grid)
+};
+
 class FigureRender {
 public:
     virtual void init() = 0;
     virtual void render() = 0;
     virtual void hide() = 0;
+
+    // Get GPU times (pass name, milliseconds) of the passes of the last measured frame
+    virtual std::vector<std::pair<std::string, float>> getPassTimes() const {
+        return {};
+    }
+
+    // Get marching steps of the last frame counted by steps view
+    virtual StepStats getStepStats() const {
+        return {};
+    }
 };
 
 class CommonRender : public FigureRender {
@@ -31,16 +62,181 @@ private:
     std::vector<Primitive*> m_spheres;
 };
 
+// Opcodes of the bytecode SDF interpreter (shaders get them as 'OP_*' defines, see 'getSharedDefines')
+enum class RMOpcode {
+    END,          // End of the program
+    PUSH_POS,     // Save current position (and accumulated matrix)
+    POP_POS,      // Restore saved position (and accumulated matrix)
+    MATRIX,       // Apply inverse matrix, index - matrix chain slot
+    TWIST,        // Apply twisting, index - twist id
+    BEND,         // Apply bending, index - bend id
+    SPHERE,       // Push sphere surface, index - sphere id
+    BOX,          // Push box surface, index - box id
+    UNION,        // Pop two surfaces, push union
+    SUNION,       // Pop two surfaces, push smooth union
+    INTERSECTION, // Pop two surfaces, push intersection
+    SUBTRACTION,  // Pop two surfaces, push subtraction
+    REPEAT,       // Move position to repetition cell, index - repeat id * 8 + neighbour cell bits
+    LIPSCHITZ,    // Divide distance of the top surface by Lipschitz bound of deformation, index - bound slot
+    BEND_MATRIX   // Set frame of the next bending parameters, index - matrix chain slot (not inverted)
+};
+
+// struct compatible with ssbo
+struct RMInstruction {
+    int opcode;
+    int index;
+};
+
+// Axis aligned bounding box
+struct RMBoundingBox {
+    math::vec3 min;
+    math::vec3 max;
+    float maxScale = 1;   // Max scale of the bounded figure transformations (sdf * maxScale >= distance)
+    float lipschitz = 1;  // Lipschitz bound of the figure own transformations (world to figure space)
+};
+
+// struct compatible with ssbo
+struct alignas(16) RMBound {
+    float cen[4] = {};
+    float halfSize[4] = {};
+    float maxScale = 1;
+};
+
 class RMRender : public FigureRender {
 public:
-    RMRender() {
+    // Max depth of the bytecode interpreter stacks
+    static constexpr int bytecodeStackSize = 32;
+    // Smooth union radius
+    static constexpr float smoothK = 0.7f;
+    // Distance scale of bent figure reaching the bend axis (distance has no Lipschitz bound there)
+    static constexpr float bendAxisStretch = 8.f;
+    // Side of the screen tile traced by one compute work group (in pixels)
+    static constexpr int computeTileSize = 16;
+    // Max number of figures in the tile list (tiles with more figures use the whole scene)
+    static constexpr int maxTileFigures = 64;
+    // Side of the pixel block covered by one cone of the depth prepass (in pixels)
+    static constexpr int coneBlockSize = 8;
+    // Side of the prepass work group (in blocks)
+    static constexpr int coneGroupSize = 8;
+    // Side of the reprojection work group (in pixels)
+    static constexpr int reprojectGroupSize = 16;
+    // Inflation of the rasterized figure bounds, multiplied by their max scale (covers hit threshold of rm shader)
+    static constexpr float proxyMargin = 0.01f;
+    // Side of the deferred lighting passes work groups (in pixels)
+    static constexpr int deferredGroupSize = 8;
+    // Frames of GPU timer queries in flight (results are read when ready, without stalls)
+    static constexpr int timerFrames = 3;
+    // Bins of the steps view histogram (one per steps count, the last one also counts greater ones)
+    static constexpr int stepsHistogramSize = 4096;
+    // Render resolution scale limits (relative to window) and change step of frame time governor
+    static constexpr float minRenderScale = 0.25f;
+    static constexpr float renderScaleStep = 0.125f;
+    // Frames to wait after resolution change (measured frame time settles)
+    static constexpr int scaleCooldownFrames = 10;
+    // Weight of the last frame time in the smoothed one
+    static constexpr float frameTimeSmoothing = 0.1f;
+    // Upscale sharpening strength at zero resolution scale
+    static constexpr float sharpness = 0.5f;
+    // Samples of the still frame (the first one is the plain frame, others are jittered and accumulated)
+    static constexpr int refinementSamples = 16;
+    // Side of the accumulation work group (in pixels)
+    static constexpr int accumulateGroupSize = 16;
+    // Cells of the point light clusters along each side of the box of drawn figures
+    static constexpr int lightGridSize = 16;
+    // Range of the point lights of light source figures
+    static constexpr float emissiveLightRange = 4.f;
+
+    explicit RMRender(bool isBytecode = false, bool isCompute = false)
+        : m_isBytecode(isBytecode),
+          m_isCompute(isCompute),
+          m_computeProgram(0),
+          m_prepassProgram(0),
+          m_lightingProgram(0),
+          m_secondaryProgram(0),
+          m_compositeProgram(0),
+          m_stepsProgram(0),
+          m_frameImage(0),
+          m_frameImageWidth(0),
+          m_frameImageHeight(0),
+          m_startImage(0),
+          m_startImageWidth(0),
+          m_startImageHeight(0),
+          m_historyImage(0),
+          m_historyImageWidth(0),
+          m_historyImageHeight(0),
+          m_prevHistoryImage(0),
+          m_prevHistoryImageWidth(0),
+          m_prevHistoryImageHeight(0),
+          m_isHistory(false),
+          m_hintImage(0),
+          m_hintImageWidth(0),
+          m_hintImageHeight(0),
+          m_normalImage(0),
+          m_normalImageWidth(0),
+          m_normalImageHeight(0),
+          m_materialImage(0),
+          m_materialImageWidth(0),
+          m_materialImageHeight(0),
+          m_effectsImage(0),
+          m_effectsImageWidth(0),
+          m_effectsImageHeight(0),
+          m_bulbLightImage(0),
+          m_bulbLightImageWidth(0),
+          m_bulbLightImageHeight(0),
+          m_proxyImage(0),
+          m_proxyImageWidth(0),
+          m_proxyImageHeight(0),
+          m_proxyVertexArray(0),
+          m_proxyFrameBuffer(0),
+          m_rasterDepthImage(0),
+          m_rasterDepthImageWidth(0),
+          m_rasterDepthImageHeight(0),
+          m_stepsBufferPixels(0),
+          m_stepsReadBuffer(0),
+          m_stepsFence(nullptr),
+          m_isSceneChanged(true),
+          m_motionRevision(0),
+          m_frameBuffer(0),
+          m_renderWidth(0),
+          m_renderHeight(0),
+          m_renderScale(1),
+          m_frameTime(0),
+          m_scaleCooldown(0),
+          m_isSimpleShading(false),
+          m_accumImage(0),
+          m_accumImageWidth(0),
+          m_accumImageHeight(0),
+          m_frameStateRevision(0),
+          m_frameCameraRevision(0),
+          m_frameWindowWidth(0),
+          m_frameWindowHeight(0),
+          m_refinementSample(0),
+          m_isHistoryJittered(false),
+          m_timerFrame(0),
+          m_revision(0),
+          m_sceneSourceCapacity(0),
+          m_isDistanceOnly(false),
+          m_repeatDepth(0),
+          m_deformedDepth(0),
+          m_variablesCount(0) {
     }
     ShaderStorageBuffer m_spheresSSBO;
     ShaderStorageBuffer m_boxesSSBO;
     ShaderStorageBuffer m_matricesSSBO;
     ShaderStorageBuffer m_twistsSSBO;
     ShaderStorageBuffer m_bendsSSBO;
-    Shader *shd;
+    ShaderStorageBuffer m_programSSBO;
+    ShaderStorageBuffer m_inverseMatricesSSBO;
+    ShaderStorageBuffer m_boundsSSBO;
+    ShaderStorageBuffer m_repeatsSSBO;
+    ShaderStorageBuffer m_lipschitzSSBO;
+    ShaderStorageBuffer m_figureBoundsSSBO;
+    ShaderStorageBuffer m_motionBoundsSSBO;
+    ShaderStorageBuffer m_stepsSSBO;
+    ShaderStorageBuffer m_lightsSSBO;
+    ShaderStorageBuffer m_lightClustersSSBO;
+
+    ~RMRender();
 
     void init() final;
 
@@ -48,22 +244,374 @@ public:
 
     void hide() final;
 
-    ~RMRender() {
-        delete shd;
-    }
+    std::vector<std::pair<std::string, float>> getPassTimes() const final;
 
-private:
-    std::string serializeOperation(const std::string &operationName, const std::vector<FigureId> &sources, const std::string &pos, const std::string &matr);
-    // TODO maybe ref??
-    std::string serializeFigureId(const FigureId &id, std::string pos, std::string matr);
+    StepStats getStepStats() const final;
 
+    // Generate SDF_scene and SDF_dist functions of current scene topology (public for codegen benchmark)
     std::string getSDFSceneSource();
 
-    std::string createFragmentSource(const std::string &filePath, const std::string &outPath);
+private:
+    // Set shader program for current scene topology (compile only if source is new)
+    void updateShaderProgram();
+
+    // Get chain of consecutive matrices (ids) ending at 'index' (index is moved to the chain beginning)
+    std::vector<int> getMatrixChain(const Figure &figure, int &index) const;
+
+    // Get all matrices (ids) applied before transformation at 'index' (they move bend parameters to its frame)
+    std::vector<int> getInnerMatrixChain(const Figure &figure, int index) const;
+
+    // Get slot of the matrix chain in inverse matrices ssbo (composed matrix is stored as is if not 'isInverse')
+    int getMatrixChainSlot(const std::vector<int> &chain, bool isInverse = true);
+
+    // Get composed matrix of the chain
+    static math::matr4 getMatrixChainProduct(const std::vector<int> &chain);
+
+    // Get inverted composed matrix of the chain
+    static math::matr4 getMatrixChainInverse(const std::vector<int> &chain);
+
+    // Get GLSL 'mat4' constructor with the same matrix
+    static std::string getMatrixLiteral(const math::matr4 &matr);
+
+    // Get inverted (or as is) composed matrix for every chain slot
+    std::vector<math::matr4> getInverseMatrices() const;
+
+    // Get world to frame matrix and max scale of frame to world transformation of every context
+    void getContextFrames(std::vector<math::matr4> &matrices, std::vector<float> &scales) const;
+
+    // Get world space bounds of every bound slot
+    std::vector<RMBound> getBounds() const;
+
+    // Get world space bounds of every drawn figure (in order of 'SDF_figure_dist' cases)
+    std::vector<RMBound> getDrawnFigureBounds() const;
+
+    // Get box of all drawn figures (inflated as their proxies)
+    static RMBoundingBox getSceneBounds(const std::vector<RMBound> &figureBounds);
+
+    // Get explicit point lights and lights of light source primitives of drawn figures
+    std::vector<PointLight> getLights() const;
+
+    // Add lights of light source primitives of the figure (matr - figure parent to world matrix)
+    void collectEmissiveLights(const FigureId &id, math::matr4 matr, std::vector<PointLight> &lights) const;
+
+    // Get offsets of every cell of the grid over the box of drawn figures to indices of the lights reaching it,
+    // followed by the indices
+    std::vector<uint> getLightClusters(const std::vector<PointLight> &lights) const;
+
+    // Get boxes swept by figures moved since the previous frame (reprojected distances are not valid inside them)
+    std::vector<RMBound> getMotionBounds(const std::vector<RMBound> &figureBounds);
+
+    // (Re)create image texture if its size changed
+    static void updateImage(uint &image, uint &imageWidth, uint &imageHeight, uint width, uint height, uint format);
+
+    // Set frame and camera uniforms of compute program (same as canvas gets in fragment mode)
+    void setComputeUniforms(uint program) const;
+
+    // Update render resolution (and secondary effects) by frame time governor
+    void updateRenderScale();
+
+    // Check if scene, camera and window are the same as in the last frame (and remember them)
+    bool updateStillFrame();
+
+    // Get sub-pixel offset of the rays of the current refinement sample (Halton sequence, 0 for the plain frame)
+    float getJitter(int base) const;
+
+    // Get secondary effects downscale of the current sample (refinement samples trace them per pixel)
+    int getSecondaryScale() const;
+
+    // Trace all passes of the frame image
+    void traceFrame();
+
+    // Add the frame image of the refinement sample to the mean of the still frame samples
+    void dispatchAccumulation();
+
+    // Trace frame image by canvas fragment shader (into framebuffer of render resolution)
+    void drawCanvas();
+
+    // Make hit distances of the last frame the previous ones and bind the current ones (written by tracing)
+    void updateHistory();
+
+    // Reproject hit distances of the previous frame to the current frame hints
+    void dispatchReprojection();
+
+    // Copy depth of the meshes drawn into window framebuffer (rays end behind them)
+    void copyRasterDepth();
+
+    // Rasterize bounds of drawn figures into ray intervals of the pixels (proxy image)
+    void drawProxies();
+
+    // March cones of pixel blocks and write start distances of the rays
+    void dispatchConePrepass();
+
+    // Trace the frame image by compute shader tiles
+    void dispatchTiles();
+
+    // Light G-buffer surfaces by direct light into the frame image
+    void dispatchLighting();
+
+    // Trace secondary effects at lower resolution and add them to the frame image
+    void dispatchSecondaryEffects();
+
+    // Read steps statistics of a previous frame (if GPU has finished it) and prepare steps buffer for the current one
+    void updateStepsBuffer();
+
+    // Replace the frame image by heatmap of marching steps and count them in histogram
+    void dispatchStepsView();
+
+    // Copy histogram of the current frame to be read back by a later frame
+    void copyStepsHistogram();
+
+    // Read pass times of the oldest frame in flight and start measuring the current one
+    void beginTimerFrame();
+
+    // Start GPU time measurement of the next pass (empty name ends the frame)
+    void markPass(const std::string &name);
+
+    // Get context of the frame of figure with transformations entered from its parent context
+    int getContext(int parentContext, int figureId);
+
+    // Get slot of the deformed figure (in parent context) Lipschitz bound
+    int getLipschitzSlot(int figureId, int context);
+
+    // Get Lipschitz bound of every deformed figure slot
+    std::vector<float> getLipschitzBounds() const;
+
+    // Get bounds of figure in frame of its parent (matr - world to parent frame matrix)
+    RMBoundingBox getFigureBounds(
+        const FigureId &id,
+        const math::matr4 &matr,
+        std::map<std::pair<int, std::vector<float>>, RMBoundingBox> &cache
+    ) const;
+
+    // Append SDF_scene (or distance only SDF_dist) function of the figures union to generated source
+    void serializeSceneFunction(const std::vector<FigureId> &figures, bool isDistanceOnly);
+
+    // Append SDF_figure_dist function (distance to one of the drawn figures) to generated source
+    void serializeFigureDistances(const std::vector<FigureId> &figures);
+
+    // Get type of figure result in generated function
+    const char *getSurfaceType() const {
+        return m_isDistanceOnly ? "float" : "Surface";
+    }
+
+    // Get access to distance of figure result in generated function
+    const char *getDistanceField() const {
+        return m_isDistanceOnly ? "" : ".sdf";
+    }
+
+    // Get prefix of primitive SDF function in generated function
+    const char *getPrimitivePrefix() const {
+        return m_isDistanceOnly ? "dist_" : "SDF_";
+    }
+
+    // Add local variable to generated SDF_scene (or reuse the same one) and return its name
+    std::string emitVariable(const std::string &type, const std::string &expression);
+
+    // Add new (not shared) local variable to generated SDF_scene and return its name
+    std::string emitUniqueVariable(const std::string &type, const std::string &expression);
+
+    // Append indented line to generated SDF_scene (parts are written directly, without temporaries)
+    void emitLine(std::initializer_list<std::string_view> parts);
+
+    // Variables and figures serialized inside of the guard block are not visible outside
+    void openScope();
+
+    void closeScope();
+
+    // Get name of the SDF operation function (nullptr for primitives)
+    static const char *getOperationName(CreationType type);
+
+    // Collect operands of the chain of same operations (figures without transformations)
+    void collectOperands(const std::vector<FigureId> &sources, CreationType type, std::vector<FigureId> &operands) const;
+
+    // Get first operand of operation (first operand of the whole chain if it is rebalanced)
+    FigureId getFirstOperand(const std::vector<FigureId> &sources, CreationType type) const;
+
+    std::string serializeOperation(
+        CreationType type,
+        const std::vector<FigureId> &sources,
+        const std::string &pos,
+        const std::string &matr,
+        int context
+    );
+
+    // Serialize operation over range of operands as balanced binary tree
+    std::string serializeBalancedOperation(
+        const std::string &operationName,
+        std::vector<FigureId>::const_iterator begin,
+        std::vector<FigureId>::const_iterator end,
+        const std::string &pos,
+        const std::string &matr,
+        int context
+    );
+
+    // Serialize operation of result and (guarded by bounds) range of operands
+    std::string serializeOperand(
+        const std::string &operationName,
+        const std::string &res,
+        std::vector<FigureId>::const_iterator begin,
+        std::vector<FigureId>::const_iterator end,
+        const std::string &pos,
+        const std::string &matr,
+        int context
+    );
+
+    // Get axes (bit mask) along which neighbour cells of repetition must be checked (0 - the nearest cell is enough)
+    int getRepeatNeighbourAxes(const Figure &figure) const;
+
+    // Serialize repetition as the nearest cell (or loop over the nearest cells) of its source figure
+    std::string serializeRepeat(const Figure &figure, const std::string &pos, const std::string &matr, int context);
+
+    std::string serializeFigureId(const FigureId &id, const std::string &pos, const std::string &matr, int context);
+
+    std::string serializeFigure(const FigureId &id, std::string pos, std::string matr, int context);
+
+    void serializeFigureIdBytecode(
+        const FigureId &id,
+        std::vector<RMInstruction> &program,
+        int posDepth,
+        int &maxPosDepth,
+        int &surfaceDepth,
+        int &maxSurfaceDepth,
+        int context
+    );
+
+    std::vector<RMInstruction> getSDFSceneProgram();
+
+    // Programs compiled from the ray marching shader source
+    enum class ShaderPass {
+        TRACING,       // Primary rays into G-buffer (canvas or compute tiles)
+        CONE_PREPASS,  // Ray start distances of pixel blocks
+        LIGHTING,      // Direct light of G-buffer surfaces
+        SECONDARY,     // Secondary effects at lower resolution
+        COMPOSITE,     // Upsample of secondary effects into the frame image
+        STEPS          // Heatmap of marching steps (steps view)
+    };
+
+    // Fill shader file with the pass defines and generated scene functions
+    std::string createFragmentSource(
+        const std::string &filePath,
+        const std::string &outPath,
+        const std::string &sceneSource,
+        ShaderPass pass = ShaderPass::TRACING
+    );
+
+    // Get compute program of the pass for current scene topology (compile only if source is new)
+    uint getPassProgram(ShaderPass pass);
 
     std::string createVertexSource(const std::string &filePath, const std::string &outPath) const;
 
-    Primitive *m_canvas;
+    // Get '#define's of the constants shared by C++ side and rm shaders (placed after '#version' of every shader)
+    static std::string getSharedDefines();
+
+    // Get '#define's of the features enabled in the scene and of steps view (placed after shared ones in every pass program)
+    static std::string getFeatureDefines();
+
+    Primitive *m_canvas;  // Tracing quad (drawn into frame image)
+    Primitive *m_screen;  // Window quad showing upscaled frame image
+    bool m_isBytecode;
+    bool m_isCompute;           // Frame is traced by compute shader tiles instead of canvas
+    uint m_computeProgram;      // Current compute program (compiled on first use)
+    uint m_prepassProgram;      // Current cone prepass program (0 - not used yet with current topology)
+    uint m_lightingProgram;     // Current direct lighting program (0 - not used yet)
+    uint m_secondaryProgram;    // Current secondary effects program (0 - not used yet)
+    uint m_compositeProgram;    // Current secondary effects upsample program (0 - not used yet)
+    uint m_stepsProgram;        // Current steps view program (0 - not used yet)
+    std::string m_passSceneSource;  // Scene functions of current topology (programs of other passes are compiled from it)
+    std::string m_featureDefines;   // Defines of the features enabled for current programs
+    std::unique_ptr<Shader> m_blitShader;  // Upscale of frame image to window
+    uint m_frameImage;          // Texture traced by compute shader or canvas (of render resolution)
+    uint m_frameImageWidth, m_frameImageHeight;
+    uint m_startImage;          // Ray start distances from camera, one texel per pixel block
+    uint m_startImageWidth, m_startImageHeight;
+    uint m_historyImage;        // Hit distances from camera of the current frame
+    uint m_historyImageWidth, m_historyImageHeight;
+    uint m_prevHistoryImage;    // Hit distances from camera of the previous frame (swapped with current one each frame)
+    uint m_prevHistoryImageWidth, m_prevHistoryImageHeight;
+    bool m_isHistory;           // Previous hit distances are of the current render resolution
+    uint m_hintImage;           // Min reprojected hit distances of the current frame
+    uint m_hintImageWidth, m_hintImageHeight;
+    uint m_normalImage;         // Normals of lit surfaces of the current frame (G-buffer with history and material images)
+    uint m_normalImageWidth, m_normalImageHeight;
+    uint m_materialImage;       // Colors and light source flags of the current frame surfaces
+    uint m_materialImageWidth, m_materialImageHeight;
+    uint m_effectsImage;        // Reflection color and occlusion (of secondary resolution)
+    uint m_effectsImageWidth, m_effectsImageHeight;
+    uint m_bulbLightImage;      // Bulb light (of secondary resolution)
+    uint m_bulbLightImageWidth, m_bulbLightImageHeight;
+    uint m_proxyImage;          // Distances to the nearest entry and to the farthest exit (negated) of figure bounds
+    uint m_proxyImageWidth, m_proxyImageHeight;
+    std::unique_ptr<Shader> m_proxyShader;  // Raster of figure bounds into proxy image (compiled on first use)
+    uint m_proxyVertexArray;  // Empty, box corners are generated by proxy shader
+    uint m_proxyFrameBuffer;  // Framebuffer with proxy image attached
+    uint m_rasterDepthImage;  // Depth of the meshes (of window resolution)
+    uint m_rasterDepthImageWidth, m_rasterDepthImageHeight;
+    uint m_stepsBufferPixels;  // Pixels of steps buffer (histogram is followed by steps of every pixel)
+    uint m_stepsReadBuffer;    // Copy of the histogram read back by CPU
+    GLsync m_stepsFence;       // Signaled when the histogram copy is finished (nullptr - no copy is pending)
+    StepStats m_stepStats;     // Of the last counted frame
+    std::unique_ptr<Shader> m_reprojectShader;  // Compiled on first use
+    math::vec3 m_prevCamPos, m_prevCamDir, m_prevCamUp, m_prevCamRight;  // Camera of the previous frame
+    std::vector<RMBound> m_prevFigureBounds;  // Bounds of drawn figures in the previous frame
+    RMBoundingBox m_sceneBounds;  // Box of all drawn figures (secondary rays are clipped by it)
+    std::vector<math::matr4> m_prevMatrices;
+    std::vector<TransformationTwist> m_prevTwistings;
+    std::vector<TransformationBend> m_prevBendings;
+    std::vector<RepeatParameters> m_prevRepeats;
+    bool m_isSceneChanged;  // Deformations or topology changed since the previous frame (no reprojection)
+    size_t m_motionRevision;  // Scene revision of the previous frame
+    uint m_frameBuffer;       // Framebuffer with frame image attached (canvas tracing)
+    uint m_renderWidth, m_renderHeight;
+    float m_renderScale;      // Render resolution relative to window
+    float m_frameTime;        // Smoothed frame time
+    int m_scaleCooldown;      // Frames until the next governor decision
+    bool m_isSimpleShading;   // Secondary rays are skipped
+    uint m_accumImage;        // Mean of the still frame samples
+    uint m_accumImageWidth, m_accumImageHeight;
+    std::unique_ptr<Shader> m_accumulateShader;  // Compiled on first use
+    size_t m_frameStateRevision, m_frameCameraRevision;  // Scene and camera revisions of the last frame
+    uint m_frameWindowWidth, m_frameWindowHeight;         // Window size of the last frame
+    int m_refinementSample;   // Sample of the still frame (0 - plain frame, 'refinementSamples' - all are accumulated)
+    bool m_isHistoryJittered; // Hit distances are of the jittered rays (not reprojected)
+    // Timestamp queries of the frame passes
+    struct RMFrameTimer {
+        std::vector<uint> queries;        // Start of every pass and end of the frame
+        std::vector<std::string> passes;  // Names of the measured passes
+    };
+    RMFrameTimer m_timers[timerFrames];
+    int m_timerFrame;         // Timer of the current frame
+    std::vector<std::pair<std::string, float>> m_passTimes;  // Of the last measured frame
+    size_t m_revision;  // Scene revision of the current shader program
+    std::string m_vertexSource;
+    std::unordered_map<std::string, std::unique_ptr<Shader>> m_shaders;  // Linked programs by fragment source
+
+    // Chains of matrix transformations (matrix ids, inversion flag) and their slots
+    std::vector<std::pair<std::vector<int>, bool>> m_matrixChains;
+    std::map<std::pair<std::vector<int>, bool>, int> m_matrixChainSlots;
+
+    // Frames of figures with transformations (parent context, figure id), context 0 - world
+    std::vector<std::pair<int, int>> m_contexts;
+    std::map<std::pair<int, int>, int> m_contextIds;
+    // Groups of figures guarded by their bounds (figure ids, context) and their slots
+    std::vector<std::pair<std::vector<int>, int>> m_boundSlots;
+    std::map<std::pair<std::vector<int>, int>, int> m_boundSlotIds;
+    // Deformed figures (figure id, parent context) and slots of their Lipschitz bounds
+    std::vector<std::pair<int, int>> m_lipschitzSlots;
+    std::map<std::pair<int, int>, int> m_lipschitzSlotIds;
+
+    // SDF_scene generation state
+    std::string m_sceneSource;
+    size_t m_sceneSourceCapacity;  // Size of the previous generated source (reserved for the next one)
+    std::string m_indent;
+    bool m_isDistanceOnly;  // Distance only function is generated (figure results are floats)
+    int m_repeatDepth;  // Number of repetitions around the current figure (bounds are unknown inside)
+    int m_deformedDepth;  // Number of twisted or bent figures around the current figure (guards are unsafe inside)
+    int m_variablesCount;
+    std::unordered_map<std::string, std::string> m_variables;  // Variable names by type and expression
+    std::map<std::tuple<int, std::string, std::string>, std::string> m_serializedFigures;  // Results by (figure, pos, matr)
+    std::vector<std::string> m_variablesLog;  // Keys of variables in order of adding
+    std::vector<std::tuple<int, std::string, std::string>> m_serializedFiguresLog;  // Keys of figures in order of adding
+    std::vector<std::pair<size_t, size_t>> m_scopes;  // Logs sizes at the beginning of every open scope
 };
 
 }
@@ -8,9 +8,11 @@ bool FigureIdHasher::operator() (const FigureId &a, const FigureId &b) const {
     return a.id() < b.id();
 }
 
-FigureScene::FigureScene() : m_curRenderType(RenderType::RM), m_is_bulb(false) {
+FigureScene::FigureScene() : m_revision(0), m_stateRevision(0), m_isBalancing(true), m_targetFrameTime(0), m_secondaryScale(1), m_maxSteps(256), m_relaxation(1), m_isStepsView(false), m_curRenderType(RenderType::RM), m_is_bulb(false) {
     m_renders[RenderType::COMMON] = std::make_shared<CommonRender>();
     m_renders[RenderType::RM] = std::make_shared<RMRender>();
+    m_renders[RenderType::RM_BYTECODE] = std::make_shared<RMRender>(true);
+    m_renders[RenderType::RM_COMPUTE] = std::make_shared<RMRender>(false, true);
 }
 
 void FigureScene::onCreate() {
@@ -23,17 +25,29 @@ void FigureScene::onUpdate() {
     for (auto &render : m_renders) {
         render.second->hide();
     }
-    m_renders[m_curRenderType]->render();
+}
+
+void FigureScene::onRender() const {
+    // Ray marching reads depth of the meshes if rays end at them (see 'RMFeature::RASTER_DEPTH')
+    renderModels();
+    m_renders.at(m_curRenderType)->render();
+    renderPrimitives();
 }
 
 void FigureScene::setRenderType(RenderType renderType) {
-    m_curRenderType = renderType;
+    if (m_curRenderType != renderType) {
+        m_curRenderType = renderType;
+        m_stateRevision++;
+    }
 }
 
 void FigureScene::setBulb(const math::vec3 &pos, const math::vec3 &color) {
-    m_is_bulb = true;
-    m_bulb_pos = pos;
-    m_bulb_color = color;
+    if (!m_is_bulb || m_bulb_pos != pos || m_bulb_color != color) {
+        m_is_bulb = true;
+        m_bulb_pos = pos;
+        m_bulb_color = color;
+        m_stateRevision++;
+    }
 }
 
 RenderType FigureScene::getRenderType() const {
@@ -53,11 +67,126 @@ const math::vec3 & FigureScene::getBulbColor() const {
 }
 
 void FigureScene::draw(const FigureId &id) {
-    m_scene.insert(id);
+    if (m_scene.insert(id).second) {
+        m_revision++;
+        m_stateRevision++;
+    }
 }
 
 void FigureScene::hide(const FigureId &id) {
-    m_scene.erase(id);
+    if (m_scene.erase(id)) {
+        m_revision++;
+        m_stateRevision++;
+    }
+}
+
+void FigureScene::addTransformation(const FigureId &id, const TransformationId &trId) {
+    m_figures[id.id()].addTransformation(trId);
+    m_revision++;
+    m_stateRevision++;
+}
+
+size_t FigureScene::getRevision() const {
+    return m_revision;
+}
+
+void FigureScene::markChanged() {
+    m_stateRevision++;
+}
+
+size_t FigureScene::getStateRevision() const {
+    return m_stateRevision;
+}
+
+void FigureScene::setBalancing(bool isBalancing) {
+    if (m_isBalancing != isBalancing) {
+        m_isBalancing = isBalancing;
+        m_revision++;
+        m_stateRevision++;
+    }
+}
+
+bool FigureScene::isBalancing() const {
+    return m_isBalancing;
+}
+
+void FigureScene::setTargetFrameTime(float targetFrameTime) {
+    m_targetFrameTime = targetFrameTime;
+}
+
+float FigureScene::getTargetFrameTime() const {
+    return m_targetFrameTime;
+}
+
+void FigureScene::setSecondaryScale(int secondaryScale) {
+    secondaryScale = std::max(secondaryScale, 1);
+    if (m_secondaryScale != secondaryScale) {
+        m_secondaryScale = secondaryScale;
+        m_stateRevision++;
+    }
+}
+
+int FigureScene::getSecondaryScale() const {
+    return m_secondaryScale;
+}
+
+std::vector<std::pair<std::string, float>> FigureScene::getPassTimes() const {
+    return m_renders.at(m_curRenderType)->getPassTimes();
+}
+
+void FigureScene::setMaxSteps(int maxSteps) {
+    maxSteps = std::max(maxSteps, 1);
+    if (m_maxSteps != maxSteps) {
+        m_maxSteps = maxSteps;
+        m_stateRevision++;
+    }
+}
+
+int FigureScene::getMaxSteps() const {
+    return m_maxSteps;
+}
+
+void FigureScene::setRelaxation(float relaxation) {
+    // Over-relaxation converges with factors below 2 only
+    relaxation = std::clamp(relaxation, 1.f, 1.99f);
+    if (m_relaxation != relaxation) {
+        m_relaxation = relaxation;
+        m_stateRevision++;
+    }
+}
+
+float FigureScene::getRelaxation() const {
+    return m_relaxation;
+}
+
+void FigureScene::setFeature(RMFeature feature, bool isEnabled) {
+    if (isFeature(feature) != isEnabled) {
+        if (isEnabled) {
+            m_features.insert(feature);
+        } else {
+            m_features.erase(feature);
+        }
+        m_stateRevision++;
+    }
+}
+
+bool FigureScene::isFeature(RMFeature feature) const {
+    return m_features.count(feature) != 0;
+}
+
+void FigureScene::setStepsView(bool isStepsView) {
+    if (m_isStepsView != isStepsView) {
+        m_isStepsView = isStepsView;
+        m_stateRevision++;
+    }
+}
+
+bool FigureScene::isStepsView() const {
+    return m_isStepsView;
+}
+
+StepStats FigureScene::getStepStats() const {
+    return m_renders.at(m_curRenderType)->getStepStats();
 }
 
 
@@ -79,6 +208,10 @@ math::matr4 & FigureScene::getMatrixById(const TransformationId &id) {
    return m_matrices[id.id()];
 }
 
+bool FigureScene::isStaticMatrix(const TransformationId &id) const {
+    return id.id() < static_cast<int>(m_isStaticMatrix.size()) && m_isStaticMatrix[id.id()];
+}
+
 TransformationTwist & FigureScene::getTransformationTwistById(const TransformationId &id) {
     return m_twistings[id.id()];
 }
@@ -87,6 +220,10 @@ TransformationBend & FigureScene::getTransformationBendById(const Transformation
     return m_bendings[id.id()];
 }
 
+PointLight & FigureScene::getLightById(const LightId &id) {
+    return m_lights[id.id()];
+}
+
 const std::vector<SpherePrimitive> & FigureScene::getSpheres() const {
     return m_spheres;
 }
@@ -107,6 +244,14 @@ const std::vector<TransformationBend> & FigureScene::getBendings() const {
     return m_bendings;
 }
 
+const std::vector<RepeatParameters> & FigureScene::getRepeats() const {
+    return m_repeats;
+}
+
+const std::vector<PointLight> & FigureScene::getLights() const {
+    return m_lights;
+}
+
 std::set<FigureId, FigureIdHasher> & FigureScene::getScene() {
     return m_scene;
 }
@@ -139,6 +284,14 @@ TransformationMatrixId FigureScene::createTransformation(const math::matr4 &matr
     return res;
 }
 
+TransformationId FigureScene::createStaticTransformation(const math::matr4 &matr) {
+    TransformationMatrixId res(static_cast<int>(m_matrices.size()));
+    m_matrices.push_back(matr);
+    m_isStaticMatrix.resize(m_matrices.size());
+    m_isStaticMatrix.back() = true;
+    return res;
+}
+
 TransformationMatrixId FigureScene::createTranslation(const math::vec3 &vec) {
     TransformationMatrixId res(static_cast<int>(m_matrices.size()));
     m_matrices.push_back(math::matr4::translate(vec));
@@ -172,6 +325,13 @@ TransformationBendId FigureScene::createBend(const math::vec3 &pos, const math::
     return res;
 }
 
+LightId FigureScene::createLight(const math::vec3 &pos, const math::vec3 &color, float range) {
+    LightId res(static_cast<int>(m_lights.size()));
+    m_lights.push_back({pos, color, range});
+    m_stateRevision++;
+    return res;
+}
+
 FigureId FigureScene::createUnion(const FigureId &a, const FigureId &b) {
     FigureId res(static_cast<int>(m_figures.size()));
     m_figures.push_back(Figure(CreationType::UNION, {a, b}));
@@ -195,4 +355,22 @@ FigureId FigureScene::createSUnion(const FigureId &a, const FigureId &b) {
     return res;
 }
 
+FigureId FigureScene::createRepeat(const FigureId &id, const math::vec3 &period, const math::vec3 &count) {
+    float per[3] = {std::abs(period.x), std::abs(period.y), std::abs(period.z)};
+    float cnt[3] = {count.x, count.y, count.z};
+    for (int i = 0; i < 3; i++) {
+        cnt[i] = std::max(1.0f, std::round(cnt[i]));
+        // Period along axis without copies is not used (but must be non-zero for cell search)
+        if (cnt[i] == 1) {
+            per[i] = 1;
+        } else if (per[i] == 0) {
+            EXCEPTION("Repeat period must be non-zero along axis with several copies");
+        }
+    }
+    FigureId res(static_cast<int>(m_figures.size()));
+    m_figures.push_back(Figure(id, static_cast<int>(m_repeats.size())));
+    m_repeats.emplace_back(math::vec3(per[0], per[1], per[2]), math::vec3(cnt[0], cnt[1], cnt[2]));
+    return res;
+}
+
 }
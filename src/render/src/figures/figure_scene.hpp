@@ -6,6 +6,7 @@
 #include "../resources/buffers/buffer.hpp"
 #include "../resources/scenes/scene.hpp"
 #include "figure_transformation.hpp"
+#include "figure_light.hpp"
 #include "figure_render.hpp"
 #include "figure.hpp"
 #include "figure_material.hpp"
@@ -19,6 +20,8 @@ struct FigureIdHasher {
 enum class RenderType {
     COMMON,
     RM,
+    RM_BYTECODE,
+    RM_COMPUTE,  // Ray marching by compute shader screen tiles (figures are culled per tile)
     RT
 };
 
@@ -30,6 +33,9 @@ public:
 
     void onUpdate() override;
 
+    // Draw models (meshes) first, figures are rendered over them with shared depth
+    void onRender() const override;
+
     void setRenderType(RenderType renderType);
 
     void setBulb(const math::vec3 &pos, const math::vec3 &color);
@@ -46,6 +52,59 @@ public:
 
     void hide(const FigureId &id);
 
+    void addTransformation(const FigureId &id, const TransformationId &trId);
+
+    // Enable/disable rebalancing of union and intersection chains in generated sdf
+    void setBalancing(bool isBalancing);
+
+    bool isBalancing() const;
+
+    // Set frame time (in seconds) kept by ray marching render resolution scaling (0 - always full resolution)
+    void setTargetFrameTime(float targetFrameTime);
+
+    float getTargetFrameTime() const;
+
+    // Set downscale of ray marching secondary effects (shadows, occlusion, reflection) relative to render resolution (1 - traced with primary rays, default)
+    void setSecondaryScale(int secondaryScale);
+
+    int getSecondaryScale() const;
+
+    // Get GPU times (pass name, milliseconds) of the current render passes
+    std::vector<std::pair<std::string, float>> getPassTimes() const;
+
+    // Set max marching steps of every ray (primary and secondary ones, ray out of steps is missed)
+    void setMaxSteps(int maxSteps);
+
+    int getMaxSteps() const;
+
+    // Set over-relaxation of marching steps (steps are this times longer than distances, 1 - plain sphere tracing),
+    // step that could skip a surface falls back to the plain one
+    void setRelaxation(float relaxation);
+
+    float getRelaxation() const;
+
+    // Enable/disable optional ray marching feature (programs are recompiled with its shader code)
+    void setFeature(RMFeature feature, bool isEnabled);
+
+    bool isFeature(RMFeature feature) const;
+
+    // Show marching steps of the pixels as heatmap instead of ray marching frame and count their statistics
+    void setStepsView(bool isStepsView);
+
+    bool isStepsView() const;
+
+    // Get marching steps per pixel of the last frame of steps view
+    StepStats getStepStats() const;
+
+    size_t getRevision() const;
+
+    // Mark drawn frame as changed (figure transformations and scene settings mark it themselves,
+    // meshes moved by units have to do it)
+    void markChanged();
+
+    // Get revision of everything drawn, changes on every topology, transformation or settings change
+    size_t getStateRevision() const;
+
     SpherePrimitive & getSpherePrimitiveById(const PrimitiveId &id);
 
     BoxPrimitive & getBoxPrimitiveById(const PrimitiveId &id);
@@ -54,10 +113,15 @@ public:
 
     math::matr4 & getMatrixById(const TransformationId &id);
 
+    // Static matrices can't be changed after creation (no handle is given out)
+    bool isStaticMatrix(const TransformationId &id) const;
+
     TransformationTwist & getTransformationTwistById(const TransformationId &id);
 
     TransformationBend & getTransformationBendById(const TransformationId &id);
 
+    PointLight & getLightById(const LightId &id);
+
     const std::vector<SpherePrimitive> & getSpheres() const;
 
     const std::vector<BoxPrimitive> & getBoxes() const;
@@ -68,6 +132,11 @@ public:
 
     const std::vector<TransformationBend> & getBendings() const;
 
+    const std::vector<RepeatParameters> & getRepeats() const;
+
+    // Get explicit point lights (light source figures give their own lights to ray marching)
+    const std::vector<PointLight> & getLights() const;
+
     std::set<FigureId, FigureIdHasher> & getScene();
 
     FigureId createCopy(const FigureId &id);
@@ -78,6 +147,9 @@ public:
 
     TransformationMatrixId createTransformation(const math::matr4 &matr);
 
+    // Create matrix that is never changed (baked into generated shaders)
+    TransformationId createStaticTransformation(const math::matr4 &matr);
+
     TransformationMatrixId createTranslation(const math::vec3 &vec);
 
     TransformationMatrixId createRotation(const math::vec3 &vec, float deg);
@@ -96,18 +168,37 @@ public:
 
     FigureId createSubtraction(const FigureId &a, const FigureId &b);
 
+    // Create point light lighting figures up to 'range' from it (in ray marching with 'RMFeature::POINT_LIGHTS', shadowed by figures)
+    LightId createLight(const math::vec3 &pos, const math::vec3 &color, float range);
+
+    // Create 'count' copies of the figure placed on the grid (centered at figure origin) with 'period' step
+    // (count is rounded to integers, per step cost does not depend on it)
+    FigureId createRepeat(const FigureId &id, const math::vec3 &period, const math::vec3 &count);
+
 private:
     std::vector<BoxPrimitive> m_boxes;
     std::vector<SpherePrimitive> m_spheres;
     std::vector<Figure> m_figures;
 
     std::vector<math::matr4> m_matrices;
+    std::vector<bool> m_isStaticMatrix;  // Static flags of matrices (missing - dynamic)
     std::vector<TransformationBend> m_bendings;
     std::vector<TransformationTwist> m_twistings;
+    std::vector<RepeatParameters> m_repeats;
+    std::vector<PointLight> m_lights;
 
     std::vector<Material> m_materials;
 
     std::set<FigureId, FigureIdHasher> m_scene;
+    size_t m_revision;  // Topology revision, changes on every draw/hide/adding transformation
+    size_t m_stateRevision;  // Drawn frame revision (see 'getStateRevision')
+    bool m_isBalancing;
+    float m_targetFrameTime;
+    int m_secondaryScale;
+    int m_maxSteps;
+    float m_relaxation;
+    bool m_isStepsView;
+    std::set<RMFeature> m_features;  // Enabled ray marching features
     RenderType m_curRenderType;
     std::map<RenderType, std::shared_ptr<FigureRender>> m_renders;
 
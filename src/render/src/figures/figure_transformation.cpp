@@ -1,3 +1,4 @@
+#include <cstring>
 #include "../../render.hpp"
 #include "figure_transformation.hpp"
 
@@ -10,8 +11,13 @@ TransformationType TransformationId::type() const {
     return m_type;
 }
 
+// Frame is marked as changed only by new values (same ones may be set every frame)
 void TransformationMatrixId::set(const math::matr4 &matr) const {
-    Render::scene.getMatrixById(*this) = matr;
+    math::matr4 &cur = Render::scene.getMatrixById(*this);
+    if (std::memcmp(&cur, &matr, sizeof(math::matr4)) != 0) {
+        cur = matr;
+        Render::scene.markChanged();
+    }
 }
 
 void TransformationBendId::set(
@@ -19,7 +25,12 @@ void TransformationBendId::set(
     const math::vec3 &dir,
     const math::vec3 &rad
 ) const {
-    Render::scene.getTransformationBendById(*this) = {pos, dir, rad};
+    TransformationBend &cur = Render::scene.getTransformationBendById(*this);
+    TransformationBend bend = {pos, dir, rad};
+    if (std::memcmp(&cur, &bend, sizeof(TransformationBend)) != 0) {
+        cur = bend;
+        Render::scene.markChanged();
+    }
 }
 
 void TransformationTwistId::set(
@@ -27,7 +38,14 @@ void TransformationTwistId::set(
     const math::vec3 &dir,
     float intensity
 ) const {
-    Render::scene.getTransformationTwistById(*this) = {pos, dir, intensity};
+    TransformationTwist &cur = Render::scene.getTransformationTwistById(*this);
+    TransformationTwist twist = {pos, dir, intensity};
+    // Padding after intensity is not compared
+    if (std::memcmp(cur.pos, twist.pos, sizeof(twist.pos)) != 0 || std::memcmp(cur.dir, twist.dir, sizeof(twist.dir)) != 0 ||
+        cur.intensity != twist.intensity) {
+        cur = twist;
+        Render::scene.markChanged();
+    }
 }
 
 } // namespace "hse"
\ No newline at end of file
@@ -139,11 +139,13 @@ public:
 class ShaderStorageBuffer {
     static std::unordered_set<uint> usedBindings;  // Used bindings set
     // (for not duplicating or lost previous data by some binding)
-    uint bufferId;  // Id of each shader storage buffer
+    uint bufferId;       // Id of each shader storage buffer
+    uint bufferBinding;  // Binding point of the buffer
 
 public:
     // Class default constructor
-    explicit ShaderStorageBuffer() = default;
+    explicit ShaderStorageBuffer() : bufferId(0), bufferBinding(0) {
+    }  // End of 'ShaderStorageBuffer' function
 
     /* Class constructor.
      * ARGUMENTS:
@@ -153,7 +155,8 @@ public:
      *       uint bufferBinding.
      */
     template <typename T>
-    ShaderStorageBuffer(const std::vector<T> &bufferData, uint bufferBinding) : bufferId(0) {
+    ShaderStorageBuffer(const std::vector<T> &bufferData, uint bufferBinding)
+        : bufferId(0), bufferBinding(bufferBinding) {
         if (usedBindings.count(bufferBinding))
             EXCEPTION(("SSBO by binding = " + std::to_string(bufferBinding) +
                        "; Try to create ssbo with already used binding")
@@ -178,6 +181,7 @@ public:
             EXCEPTION(("SSBO by binding = " + std::to_string(bufferBinding) +
                        "; Try to create ssbo with already used binding")
                           .c_str());
+        this->bufferBinding = bufferBinding;
         glGenBuffers(1, &bufferId);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
         glBufferData(GL_SHADER_STORAGE_BUFFER, bufferData.size() * sizeof(T), (void *)&bufferData[0], GL_DYNAMIC_COPY);
@@ -191,11 +195,14 @@ public:
      *   - buffer's data:
      *       const std::vector<T> &bufferData;
      * RETURNS: None.
+     * NOTE: The buffer is re-bound to its binding point, because several
+     * buffers (of different renders) may share the same binding.
      */
     template <typename T>
     void updateData(const std::vector<T> &bufferData) {
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferId);
         glBufferData(GL_SHADER_STORAGE_BUFFER, bufferData.size() * sizeof(T), (void *)&bufferData[0], GL_DYNAMIC_COPY);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bufferBinding, bufferId);
         glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
     }  // End of 'updateData' function
 
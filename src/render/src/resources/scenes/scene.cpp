@@ -20,11 +20,27 @@ Scene::Scene(std::string sceneName_)
  * RETURNS: None.
  */
 void Scene::onRender() const {
+    renderModels();
+    renderPrimitives();
+}  // End of 'Scene::onRender' function
+
+/* Render scene models function.
+ * ARGUMENTS: None.
+ * RETURNS: None.
+ */
+void Scene::renderModels() const {
     for (auto &modelInstance : modelsArray)
         if (modelInstance->getVisibility()) modelInstance->onRender(mainCamera);
+}  // End of 'Scene::renderModels' function
+
+/* Render scene primitives function.
+ * ARGUMENTS: None.
+ * RETURNS: None.
+ */
+void Scene::renderPrimitives() const {
     for (auto &primitiveInstance : primitivesArray)
         if (primitiveInstance->getVisibility()) primitiveInstance->onRender(mainCamera);
-}  // End of 'Scene::onRender' function
+}  // End of 'Scene::renderPrimitives' function
 
 /* Delete scene function.
  * ARGUMENTS: None.
@@ -55,12 +55,24 @@ protected:
     // Class virtual destructor
     virtual ~Scene() = default;
 
+    /* Render scene models function.
+     * ARGUMENTS: None.
+     * RETURNS: None.
+     */
+    void renderModels() const;
+
+    /* Render scene primitives function.
+     * ARGUMENTS: None.
+     * RETURNS: None.
+     */
+    void renderPrimitives() const;
+
 private:
     /* Render scene function.
      * ARGUMENTS: None.
      * RETURNS: None.
      */
-    void onRender() const;
+    virtual void onRender() const;
 
     /* Delete scene function.
      * ARGUMENTS: None.
@@ -1,3 +1,5 @@
+#include <filesystem>
+#include <random>
 #include "shader.hpp"
 
 namespace hse {
@@ -32,6 +34,11 @@ void Shader::parseShaderFromFile(const std::string &shaderPath) {
  * RETURNS: None.
  */
 void Shader::createShaderProgram(const std::string &shaderProgramDebugName) {
+    std::string cacheKey = getBinaryCacheKey();
+    BinaryCacheHeader cacheHeader = {getCacheDigest(cacheKey), cacheKey.size(), 0};
+    std::string cachePath = cacheKey.empty() ? "" : getBinaryCachePath(cacheHeader.digest);
+    if (!cachePath.empty() && loadProgramBinary(cachePath, cacheHeader)) return;
+
     for (auto &shader : shaders) {
         shader.id = glCreateShader(shader.type);
         if (shader.id == 0) EXCEPTION("Error in shader creation");
@@ -54,6 +61,7 @@ void Shader::createShaderProgram(const std::string &shaderProgramDebugName) {
     } else {
         for (auto &[name, type, id, source] : shaders)
             if (id != 0) glAttachShader(programId, id);
+        if (!cachePath.empty()) glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(programId);
         int linkStatus;
         glGetProgramiv(programId, GL_LINK_STATUS, &linkStatus);
@@ -62,9 +70,148 @@ void Shader::createShaderProgram(const std::string &shaderProgramDebugName) {
             glGetProgramInfoLog(programId, sizeof(logBuffer), &linkStatus, logBuffer);
             EXCEPTION("Shader log:\n" + shaderProgramDebugName + ": \n" + logBuffer);
         }
+        if (!cachePath.empty()) saveProgramBinary(cachePath, cacheHeader);
     }
 }  // End of 'Shader::createShaderProgram' function
 
+/* Get digest of the program binary cache key function.
+ * ARGUMENTS:
+ *   - cache key:
+ *       const std::string &key;
+ * RETURNS:
+ *   (std::uint64_t) - FNV-1a digest (the same for every build and platform).
+ */
+std::uint64_t Shader::getCacheDigest(const std::string &key) {
+    std::uint64_t digest = 14695981039346656037ull;
+    for (char c : key) {
+        digest ^= static_cast<unsigned char>(c);
+        digest *= 1099511628211ull;
+    }
+    return digest;
+}  // End of 'Shader::getCacheDigest' function
+
+/* Get key of the program binary cache for current shaders and driver function.
+ * ARGUMENTS: None.
+ * RETURNS:
+ *   (std::string) - cache key or empty string if cache is unavailable.
+ * NOTE: Binary is valid only for the same driver, so the key consists of
+ * all shaders types and sources and GL vendor, renderer and version strings.
+ */
+std::string Shader::getBinaryCacheKey() const {
+    int numBinaryFormats = 0;
+    if (glProgramBinary == nullptr || glGetProgramBinary == nullptr) return "";
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats);
+    if (numBinaryFormats <= 0) return "";
+
+    std::string key;
+    for (auto &[name, type, id, source] : shaders)
+        key += std::to_string(type) + ':' + source + '\0';
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        if (const GLubyte *str = glGetString(name); str != nullptr) key += reinterpret_cast<const char *>(str) + std::string(1, '\0');
+    return key;
+}  // End of 'Shader::getBinaryCacheKey' function
+
+/* Get path of the program binary cache file function.
+ * ARGUMENTS:
+ *   - cache key digest:
+ *       std::uint64_t digest;
+ * RETURNS:
+ *   (std::string) - cache file path or empty string if cache directory is unknown.
+ */
+std::string Shader::getBinaryCachePath(std::uint64_t digest) {
+    std::filesystem::path cacheDir;
+    if (const char *xdgCache = std::getenv("XDG_CACHE_HOME"); xdgCache != nullptr && *xdgCache != 0)
+        cacheDir = xdgCache;
+    else if (const char *home = std::getenv("HOME"); home != nullptr && *home != 0)
+        cacheDir = std::filesystem::path(home) / ".cache";
+    else
+        return "";
+    cacheDir /= "hse_project/shaders";
+
+    std::stringstream fileName;
+    fileName << std::hex << digest << ".bin";
+    return (cacheDir / fileName.str()).string();
+}  // End of 'Shader::getBinaryCachePath' function
+
+/* Load shader program from binary cache file function.
+ * ARGUMENTS:
+ *   - cache file path:
+ *       const std::string &cachePath;
+ *   - expected header of the file (binary format is not checked):
+ *       const BinaryCacheHeader &header;
+ * RETURNS:
+ *   (bool) - true if program was loaded and accepted by the driver, false otherwise.
+ */
+bool Shader::loadProgramBinary(const std::string &cachePath, const BinaryCacheHeader &header) {
+    std::ifstream cacheFile(cachePath, std::ios::binary);
+    if (!cacheFile.is_open()) return false;
+
+    // File of other key (or of older format) is never loaded
+    BinaryCacheHeader fileHeader;
+    std::vector<char> binary;
+    cacheFile.read(reinterpret_cast<char *>(&fileHeader), sizeof(fileHeader));
+    if (!cacheFile.good() || fileHeader.digest != header.digest || fileHeader.keySize != header.keySize) return false;
+    binary.assign(std::istreambuf_iterator<char>(cacheFile), std::istreambuf_iterator<char>());
+    if (!cacheFile.good() && !cacheFile.eof()) return false;
+    if (binary.empty()) return false;
+
+    programId = glCreateProgram();
+    if (programId == 0) return false;
+    glProgramBinary(programId, static_cast<GLenum>(fileHeader.format), binary.data(), static_cast<int>(binary.size()));
+    int linkStatus;
+    glGetProgramiv(programId, GL_LINK_STATUS, &linkStatus);
+    if (!linkStatus) {
+        // Binary is rejected (e.g. driver was updated) - it will be rewritten after normal compilation
+        glDeleteProgram(programId);
+        programId = 0;
+        return false;
+    }
+    return true;
+}  // End of 'Shader::loadProgramBinary' function
+
+/* Save linked shader program to binary cache file function.
+ * ARGUMENTS:
+ *   - cache file path:
+ *       const std::string &cachePath;
+ *   - header of the file (binary format is filled by the driver):
+ *       BinaryCacheHeader header;
+ * RETURNS: None.
+ * NOTE: Cache is optional, so all errors are ignored.
+ */
+void Shader::saveProgramBinary(const std::string &cachePath, BinaryCacheHeader header) const {
+    int binaryLength = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0) return;
+
+    GLenum binaryFormat;
+    std::vector<char> binary(binaryLength);
+    glGetProgramBinary(programId, binaryLength, &binaryLength, &binaryFormat, binary.data());
+    header.format = binaryFormat;
+    if (binaryLength <= 0) return;
+
+    std::error_code errorCode;
+    std::filesystem::path path(cachePath);
+    std::filesystem::create_directories(path.parent_path(), errorCode);
+    if (errorCode) return;
+
+    // Write to temporary file of this instance first, so other instances never read (or write) partially written binary
+    std::filesystem::path tmpPath = path;
+    tmpPath += "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream cacheFile(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!cacheFile.is_open()) return;
+        cacheFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        cacheFile.write(binary.data(), binaryLength);
+        if (!cacheFile.good()) {
+            cacheFile.close();
+            std::filesystem::remove(tmpPath, errorCode);
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, errorCode);
+    if (errorCode) std::filesystem::remove(tmpPath, errorCode);
+}  // End of 'Shader::saveProgramBinary' function
+
 // Class default constructor
 Shader::Shader() : programId(0) {
 }  // End of 'Shader::Shader' function
@@ -100,6 +247,18 @@ Shader::Shader(const std::string &vertexShaderSource, const std::string &fragmen
     createShaderProgram("Shader created by strings");
 }  // End of 'Shader::Shader' function
 
+/* Class constructor of single stage program (e.g. compute shader).
+ * ARGUMENTS:
+ *   - shader type:
+ *       int shaderType;
+ *   - shader source:
+ *       const std::string &shaderSource.
+ */
+Shader::Shader(int shaderType, const std::string &shaderSource) : programId(0) {
+    shaders = {{shaderType == GL_COMPUTE_SHADER ? "compute" : "single stage", shaderType, 0, shaderSource}};
+    createShaderProgram("Single stage shader created by string");
+}  // End of 'Shader::Shader' function
+
 /* Get shader id function.
  * ARGUMENTS: None.
  * RETURNS:
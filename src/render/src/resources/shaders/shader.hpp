@@ -36,6 +36,59 @@ class Shader {
      */
     void createShaderProgram(const std::string &shaderProgramDebugName);
 
+    // Header of the program binary cache file
+    struct BinaryCacheHeader {
+        std::uint64_t digest;   // Digest of the cache key
+        std::uint64_t keySize;  // Size of the cache key (in bytes)
+        std::uint64_t format;   // Binary format of the driver (64-bit, so the header has no padding)
+    };
+
+    /* Get digest of the program binary cache key function.
+     * ARGUMENTS:
+     *   - cache key:
+     *       const std::string &key;
+     * RETURNS:
+     *   (std::uint64_t) - FNV-1a digest (the same for every build and platform).
+     */
+    static std::uint64_t getCacheDigest(const std::string &key);
+
+    /* Get key of the program binary cache for current shaders and driver function.
+     * ARGUMENTS: None.
+     * RETURNS:
+     *   (std::string) - cache key or empty string if cache is unavailable.
+     */
+    std::string getBinaryCacheKey() const;
+
+    /* Get path of the program binary cache file function.
+     * ARGUMENTS:
+     *   - cache key digest:
+     *       std::uint64_t digest;
+     * RETURNS:
+     *   (std::string) - cache file path or empty string if cache directory is unknown.
+     */
+    static std::string getBinaryCachePath(std::uint64_t digest);
+
+    /* Load shader program from binary cache file function.
+     * ARGUMENTS:
+     *   - cache file path:
+     *       const std::string &cachePath;
+     *   - expected header of the file (binary format is not checked):
+     *       const BinaryCacheHeader &header;
+     * RETURNS:
+     *   (bool) - true if program was loaded and accepted by the driver, false otherwise.
+     */
+    bool loadProgramBinary(const std::string &cachePath, const BinaryCacheHeader &header);
+
+    /* Save linked shader program to binary cache file function.
+     * ARGUMENTS:
+     *   - cache file path:
+     *       const std::string &cachePath;
+     *   - header of the file (binary format is filled by the driver):
+     *       BinaryCacheHeader header;
+     * RETURNS: None.
+     */
+    void saveProgramBinary(const std::string &cachePath, BinaryCacheHeader header) const;
+
 public:
     // Class default constructor
     explicit Shader();
@@ -60,6 +113,15 @@ public:
      */
     explicit Shader(const std::string &vertexShaderSource, const std::string &fragmentShaderSource);
 
+    /* Class constructor of single stage program (e.g. compute shader).
+     * ARGUMENTS:
+     *   - shader type:
+     *       int shaderType;
+     *   - shader source:
+     *       const std::string &shaderSource.
+     */
+    explicit Shader(int shaderType, const std::string &shaderSource);
+
     // Class destructor
     ~Shader();
 
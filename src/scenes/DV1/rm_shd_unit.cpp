@@ -71,6 +71,7 @@ void rmShdScene::onCreate() {
     //handle.draw();
     laser.draw();
     //hole.draw();
+    figIds.push_back(hole);
 #elif EXAMPLE == 5 // pixar lamp
 
     Material LightSteelBlue(vec3(176, 196, 222) / 255);
@@ -160,6 +161,48 @@ void rmShdScene::onCreate() {
     cube.draw();
 
     floor.hide();
+#elif EXAMPLE == 7
+    // Repeated figures: spheres fit in their cells, rotated boxes need neighbour cells check
+    auto sphere = scene.createSphere(0.3, Goldenrod);
+    auto spheres = scene.createRepeat(sphere, vec3(1, 1, 1), vec3(9, 1, 9));
+    spheres << matr4::translate(vec3(0, 0.8, 0));
+    spheres.draw();
+    rotationId = scene.createRotation(vec3(0, 1, 0), 0);
+    auto box = scene.createBox(0.6, Crimson);
+    box << rotationId;
+    auto boxes = scene.createRepeat(box, vec3(0.9, 0, 0.9), vec3(3, 1, 3));
+    boxes << matr4::translate(vec3(0, 2, 0));
+    boxes.draw();
+#elif EXAMPLE == 8
+    // Many point lights: colored light source spheres circle around figures (lit only by the lights reaching them)
+    auto box = scene.createBox(1, Crimson);
+    box << matr4::translate(vec3(0, 1, 0));
+    box.draw();
+    auto sphere = scene.createSphere(0.6, Goldenrod);
+    sphere << matr4::translate(vec3(1.8, 1.1, -1.2));
+    sphere.draw();
+    rotationId = scene.createRotation(vec3(0, 1, 0), 0);
+    for (int i = 0; i < 12; i++) {
+        float a = i * 2 * 3.14159265f / 12;
+        vec3 color(0.5f + 0.5f * cos(a), 0.5f + 0.5f * cos(a + 2.1f), 0.5f + 0.5f * cos(a + 4.2f));
+        auto lamp = scene.createSphere(0.1, Material(color, true));
+        lamp << matr4::translate(vec3(cos(a) * 3, 0.8f + 0.3f * sin(a * 3), sin(a) * 3)) << rotationId;
+        lamp.draw();
+    }
+    scene.createLight(vec3(0, 4, 0), vec3(1, 0.9, 0.7) * 4, 6);
+    scene.setFeature(RMFeature::POINT_LIGHTS, true);
+#elif EXAMPLE == 9
+    // Twisted CSG: operands inside of twisting are not guarded by bounds (they are not twisted)
+    auto column = scene.createBox(0.3, Crimson);
+    column << matr4::scale(vec3(1, 6, 1)) << matr4::translate(vec3(0, 1.8, 0));
+    auto ball = scene.createSphere(0.5, Goldenrod);
+    auto cut = scene.createBox(0.4, MediumAquamarine);
+    ball &= cut;
+    ball << matr4::translate(vec3(-1.5, 3, 0));
+    twistId = scene.createTwist(vec3(0, 0, 0), vec3(0, 1, 0), 0);
+    column |= ball;
+    column << twistId;
+    column.draw();
 #endif
 
     math::vec3 newCameraLocation = math::vec3(1, 0.7, 1) * 5;
@@ -183,6 +226,67 @@ void rmShdScene::onUpdate() {
     if (keys[GLFW_KEY_R].action == GLFW_PRESS) {
         scene.setRenderType(RenderType::RM);
     }
+    if (keys[GLFW_KEY_B].action == GLFW_PRESS) {
+        scene.setRenderType(RenderType::RM_BYTECODE);
+    }
+    if (keys[GLFW_KEY_T].action == GLFW_PRESS) {
+        scene.setRenderType(RenderType::RM_COMPUTE);
+    }
+    // Keep 60 fps by ray marching resolution or always use full one
+    if (keys[GLFW_KEY_G].action == GLFW_PRESS) {
+        scene.setTargetFrameTime(1 / 60.f);
+    }
+    if (keys[GLFW_KEY_F].action == GLFW_PRESS) {
+        scene.setTargetFrameTime(0);
+    }
+    // Print GPU times of the render passes (and marching steps if they are shown)
+    static bool isPassKeyPressed = false;
+    if (keys[GLFW_KEY_P].action == GLFW_PRESS && !isPassKeyPressed) {
+        for (auto &[name, passTime] : scene.getPassTimes()) {
+            std::cout << name << ": " << passTime << " ms" << std::endl;
+        }
+        if (scene.isStepsView()) {
+            StepStats stats = scene.getStepStats();
+            std::cout << "steps per pixel: " << stats.average << " average, " << stats.percentile99 << " p99" << std::endl;
+        }
+    }
+    isPassKeyPressed = keys[GLFW_KEY_P].action != GLFW_RELEASE;
+    // Show marching steps heatmap instead of the frame
+    static bool isStepsKeyPressed = false;
+    if (keys[GLFW_KEY_M].action == GLFW_PRESS && !isStepsKeyPressed) {
+        scene.setStepsView(!scene.isStepsView());
+    }
+    isStepsKeyPressed = keys[GLFW_KEY_M].action != GLFW_RELEASE;
+    // Switch over-relaxed marching steps on and off
+    static bool isRelaxationKeyPressed = false;
+    if (keys[GLFW_KEY_O].action == GLFW_PRESS && !isRelaxationKeyPressed) {
+        scene.setRelaxation(scene.getRelaxation() > 1 ? 1 : 1.4f);
+    }
+    isRelaxationKeyPressed = keys[GLFW_KEY_O].action != GLFW_RELEASE;
+    // Trace secondary effects at half of render resolution or at full one
+    static bool isSecondaryKeyPressed = false;
+    if (keys[GLFW_KEY_L].action == GLFW_PRESS && !isSecondaryKeyPressed) {
+        scene.setSecondaryScale(scene.getSecondaryScale() > 1 ? 1 : 2);
+    }
+    isSecondaryKeyPressed = keys[GLFW_KEY_L].action != GLFW_RELEASE;
+    // Switch optional ray marching features on and off by number keys
+    const std::pair<int, RMFeature> featureKeys[] = {
+        {GLFW_KEY_1, RMFeature::CONE_PREPASS},
+        {GLFW_KEY_2, RMFeature::REPROJECTION},
+        {GLFW_KEY_3, RMFeature::DEFERRED},
+        {GLFW_KEY_4, RMFeature::PROXIES},
+        {GLFW_KEY_5, RMFeature::RASTER_DEPTH},
+        {GLFW_KEY_6, RMFeature::SCENE_CLIPPING},
+        {GLFW_KEY_7, RMFeature::REFINEMENT},
+        {GLFW_KEY_8, RMFeature::POINT_LIGHTS}
+    };
+    static std::map<int, bool> isFeatureKeyPressed;
+    for (const auto &[key, feature] : featureKeys) {
+        if (keys[key].action == GLFW_PRESS && !isFeatureKeyPressed[key]) {
+            scene.setFeature(feature, !scene.isFeature(feature));
+        }
+        isFeatureKeyPressed[key] = keys[key].action != GLFW_RELEASE;
+    }
 
 #if EXAMPLE == 1
     float t = time * 3;
@@ -205,6 +309,16 @@ void rmShdScene::onUpdate() {
     bendId.set(pos, vec3(0, 0, 1), vec3(0) - pos);
     translateId.set(matr4::translate(pos));
 #elif EXAMPLE == 4
+    // Toggle hole visibility (each topology is compiled only once)
+    static bool isHoleKeyPressed = false;
+    if (keys[GLFW_KEY_H].action == GLFW_PRESS && !isHoleKeyPressed) {
+        if (scene.getScene().count(figIds[0])) {
+            figIds[0].hide();
+        } else {
+            figIds[0].draw();
+        }
+    }
+    isHoleKeyPressed = keys[GLFW_KEY_H].action != GLFW_RELEASE;
     float t = time * 0.8;
     translateId.set(matr4::translate(vec3(sin(t) * 4, 0, 0)));
     if (cos(t) > 0) {
@@ -287,6 +401,10 @@ void rmShdScene::onUpdate() {
         float z = 2 * sin(t * (i % 3 + 1) + 3445 + 32 * i);
         trIds[i].set(matr4::translate(vec3(x, y, z)));
     }
+#elif EXAMPLE == 7 || EXAMPLE == 8
+    rotationId.set(matr4::rotate(time * 30, vec3(0, 1, 0)));
+#elif EXAMPLE == 9
+    twistId.set(vec3(0, 0, 0), vec3(0, 1, 0), sin(time));
 #endif
 
 #if EXAMPLE != 5 && EXAMPLE != 6
@@ -19,6 +19,7 @@ public:
     TransformationBendId bendId;
     TransformationTwistId twistId;
     std::vector<TransformationMatrixId> trIds;
+    std::vector<FigureId> figIds;
 
     // Class constructor
     explicit rmShdScene() = default;
@@ -17,6 +17,18 @@ class Camera {
     math::matr4 view,                  // View matrix for current camera
         projection,                    // Projection matrix for current camera
         viewProjection;                // VP matrix for current camera
+    size_t revision;                   // Revision of view and projection, changes with their values
+
+    /* Check if two matrices are the same function.
+     * ARGUMENTS:
+     *   - matrices to compare:
+     *       const math::matr4 &a, &b.
+     * RETURNS:
+     *   (bool) - true if all elements are equal.
+     */
+    static bool isSameMatrix(const math::matr4 &a, const math::matr4 &b) {
+        return std::equal(&a.matrix[0][0], &a.matrix[0][0] + 16, &b.matrix[0][0]);
+    }  // End of 'isSameMatrix' function
 
 public:
     // Class default constructor
@@ -30,7 +42,8 @@ public:
           projectionSize(0.1),
           view(math::matr4::identity()),
           projection(math::matr4::identity()),
-          viewProjection(math::matr4::identity()) {
+          viewProjection(math::matr4::identity()),
+          revision(0) {
     }  // End of 'Camera' function
 
     /* Class constructor function.
@@ -42,7 +55,7 @@ public:
      * NOTE: Near and far can be changed in the future.
      */
     explicit Camera(const math::vec3 &position_, const math::vec3 &direction_, const uint width_, const uint height_)
-        : width(width_), height(height_), projectionSize(0.1) {
+        : width(width_), height(height_), projectionSize(0.1), revision(0) {
         setProjection();
         setPositionWithDirection(position_, direction_);
     }  // End of 'Camera' function
@@ -61,10 +74,10 @@ public:
           up(up_),
           width(width_),
           height(height_),
-          projectionSize(0.1) {
+          projectionSize(0.1),
+          revision(0) {
         setProjection();
-        view = math::matr4::getView(position, direction, right, up);
-        viewProjection = view * projection;
+        setView();
     }  // End of 'Camera' function
 
     /* Set projection matrix function. (when window sizes have been changed)
@@ -90,9 +103,14 @@ public:
                         std::max(1.0f, static_cast<float>(width) / static_cast<float>(height)) * projectionSize,
                     projectionHeight =
                         std::max(1.0f, static_cast<float>(height) / static_cast<float>(width)) * projectionSize;
-        projection = math::matr4::getProjection(
+        math::matr4 newProjection = math::matr4::getProjection(
             -projectionWidth / 2, projectionWidth / 2, -projectionHeight / 2, projectionHeight / 2, projectionSize, far
         );
+        // Called every frame, revision is changed by the new values only
+        if (!isSameMatrix(projection, newProjection)) {
+            projection = newProjection;
+            revision++;
+        }
         viewProjection = view * projection;
     }  // End of 'setProjection' function
 
@@ -101,7 +119,11 @@ public:
      * RETURNS: None.
      */
     void setView() {
-        view = math::matr4::getView(position, direction, right, up);
+        math::matr4 newView = math::matr4::getView(position, direction, right, up);
+        if (!isSameMatrix(view, newView)) {
+            view = newView;
+            revision++;
+        }
         viewProjection = view * projection;
     }  // End of 'setView' function
 
@@ -326,6 +348,15 @@ public:
         return viewProjection;
     }  // End of 'getViewProjection' function
 
+    /* Get camera revision function.
+     * ARGUMENTS: None.
+     * RETURNS:
+     *   (size_t) - revision, changes on every change of view or projection.
+     */
+    size_t getRevision() const {
+        return revision;
+    }  // End of 'getRevision' function
+
     // Class destructor
     ~Camera() {
     }  // End of '~Camera' function
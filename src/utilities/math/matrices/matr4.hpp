@@ -479,6 +479,34 @@ public:
         );
     }  // End of 'transposing' function
 
+    /* Get maximal scale (largest singular value of the linear part) of the matrix function.
+     * ARGUMENTS: None.
+     * RETURNS:
+     *   (float) - maximal length of the transformed unit vector.
+     * NOTE: Computed as square root of the largest eigenvalue of M * M^T
+     * (symmetric 3x3 matrix, closed form solution).
+     */
+    inline float maxScale() const {
+        float a[3][3];
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                a[i][j] = matrix[i][0] * matrix[j][0] + matrix[i][1] * matrix[j][1] + matrix[i][2] * matrix[j][2];
+
+        const float p1 = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        if (p1 == 0) return std::sqrt(std::max(a[0][0], std::max(a[1][1], a[2][2])));
+
+        const float q = (a[0][0] + a[1][1] + a[2][2]) / 3;
+        const float p2 = (a[0][0] - q) * (a[0][0] - q) + (a[1][1] - q) * (a[1][1] - q) + (a[2][2] - q) * (a[2][2] - q) +
+                         2 * p1;
+        const float p = std::sqrt(p2 / 6);
+        const float r = matr3Det(
+                            a[0][0] - q, a[0][1], a[0][2], a[1][0], a[1][1] - q, a[1][2], a[2][0], a[2][1], a[2][2] - q
+                        ) /
+                        (2 * p * p * p);
+        const float phi = std::acos(std::min(std::max(r, -1.0f), 1.0f)) / 3;
+        return std::sqrt(std::max(q + 2 * p * std::cos(phi), 0.0f));
+    }  // End of 'maxScale' function
+
     /* Matrix identity function.
      * ARGUMENTS: None.
      * RETURNS:
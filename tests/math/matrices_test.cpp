@@ -149,6 +149,33 @@ TEST_CASE("Test transformation matrices") {
         CHECK(is_equal((tr1 * tr1).getPosition(), std::vector<float>{2, 4, 6}));
     }
 
+    SUBCASE("Max scale") {
+        Matr identity;
+        Matr sc = Matr::scale(Vec(2, 5, 3));
+        Matr rot = Matr::rotate(30, Vec(1, 1, 0).normalizing());
+
+        CHECK(fabs(identity.maxScale() - 1) < EPS);
+        CHECK(fabs(Matr::translate(Vec(1, 2, 3)).maxScale() - 1) < EPS);
+        CHECK(fabs(rot.maxScale() - 1) < EPS);
+        CHECK(fabs(sc.maxScale() - 5) < EPS);
+        CHECK(fabs((rot * sc).maxScale() - 5) < EPS);
+        CHECK(fabs((sc * rot).maxScale() - 5) < EPS);
+
+        // Compare with maximum over sampled directions
+        Matr m = sc * rot * sc;
+        float sampled = 0;
+        for (int i = 0; i <= 200; i++) {
+            for (int j = 0; j < 400; j++) {
+                float theta = math::PI * i / 200, phi = 2 * math::PI * j / 400;
+                Vec dir(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+                sampled = std::max(sampled, !(m.transformPoint(dir) - m.transformPoint(Vec(0))));
+            }
+        }
+        CHECK(m.maxScale() >= sampled - sampled * EPS);
+        CHECK(m.maxScale() <= sampled + sampled * EPS);
+        CHECK(m.maxScale() <= sc.maxScale() * sc.maxScale() + EPS);
+    }
+
     ///TODO make tests for scale and rotate and getView
 
 }